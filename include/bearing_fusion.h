@@ -0,0 +1,43 @@
+#ifndef BEARING_FUSION_H
+#define BEARING_FUSION_H
+
+// Emitter position from bearing lines of several arrays.
+//
+// Each bearing constrains the emitter to a line through the array origin.
+// The line is written as two scalar measurements n . p = n . origin, one
+// per unit normal of the bearing, and each is folded into a recursive
+// least squares estimate with a rank-one (Sherman-Morrison) update of the
+// covariance. Adding a bearing is O(1) and the normal equations are never
+// refactored. A forgetting factor lets the estimate follow a moving
+// emitter.
+class bearing_fusion
+{
+public:
+    bearing_fusion(double forgetting = 0.99, double bearing_sigma = 0.035,
+                   double prior_sigma = 1000.0, double min_range = 1.0);
+
+    // restart the estimate at a prior position
+    void reset(const double prior[3]);
+    // fold in one bearing; origin and unit direction in the world frame
+    void add(const double origin[3], const double dir[3]);
+
+    const double *position() const { return p_; }
+    // 3x3 row major covariance of position() [m^2]
+    const double *covariance() const { return P_; }
+
+    int bearings_ = 0;
+
+private:
+    void update(const double n[3], double y, double r);
+
+    double lambda_;
+    double sigma2_;
+    double prior_var_;
+    double min_range_;
+    bool have_prior_ = false;
+
+    double p_[3];
+    double P_[9];
+};
+
+#endif // BEARING_FUSION_H
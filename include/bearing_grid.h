@@ -0,0 +1,57 @@
+#ifndef BEARING_GRID_H
+#define BEARING_GRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Emitter likelihood heatmap on a fixed 2D world grid.
+//
+// Every bearing adds a wedge shaped likelihood from the array position
+// along the bearing. The wedge weight is along^2 / (along^2 + cross^2 /
+// tan^2(sigma)), a Cauchy profile in the angle off the bearing, which
+// needs no trig per cell; the update runs four cells at a time over the
+// bounding box of the wedge. Old evidence decays exponentially, applied
+// lazily by scaling new evidence up instead of old evidence down, with a
+// rare full-grid renormalisation. Storage is allocated once at
+// construction.
+class bearing_grid
+{
+public:
+    typedef float v4sf __attribute__((vector_size(16)));
+
+    bearing_grid(int width, int height, double resolution, double origin_x, double origin_y,
+                 double half_life, double wedge_sigma, double max_range);
+
+    // add a bearing from (x, y) along the unit direction (dx, dy) at time t [s]
+    void add(double x, double y, double dx, double dy, double t, double weight = 1.0);
+
+    // write every cell row major into width * height entries, scaled so
+    // the largest cell maps to 100; returns the decayed value of that
+    // largest cell at time t
+    float snapshot(double t, int8_t *out) const;
+    void clear();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t bytes() const { return cells_.size() * sizeof(v4sf); }
+
+private:
+    void renormalize(double t);
+
+    int width_, height_;
+    int stride_;    // row length in v4sf
+    double resolution_, origin_x_, origin_y_;
+    double tau_;
+    double wedge_k_;
+    double half_angle_;
+    double max_range_;
+
+    // evidence is stored multiplied by exp((t - t_ref_) / tau_)
+    double t_ref_ = 0;
+    bool have_t_ref_ = false;
+
+    std::vector<v4sf> cells_;
+};
+
+#endif // BEARING_GRID_H
@@ -0,0 +1,191 @@
+#ifndef BEARING_LOG_H
+#define BEARING_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Compact columnar log of parsed bearings.
+//
+// The file is a small header followed by blocks of up to
+// BEARING_LOG_BLOCK records. Each block stores its columns (delta coded
+// stamps, receive stamps, ids, azimuths, elevations, device ids) one after
+// the other, deflate compressed, behind a header carrying the time range
+// and summary sums of the block. A sparse index of the block headers is
+// appended on close; a log without one (e.g. after a crash) is recovered by
+// walking the block headers.
+
+#define BEARING_LOG_MAGIC "RFDFLOG1"
+#define BEARING_LOG_INDEX_MAGIC "RFDFIDX1"
+#define BEARING_LOG_VERSION 1
+// records per compressed block
+#define BEARING_LOG_BLOCK 4096
+// records buffered between the node and the writer thread
+#define BEARING_LOG_QUEUE 65536
+
+struct bearing_record
+{
+    int64_t stamp;      // sample time [ns]
+    int64_t recv_stamp; // host receive time [ns]
+    int32_t id;
+    float azimuth;
+    float elevation;
+    uint16_t device;
+};
+
+// per block sums, enough to merge statistics without decompressing
+struct bearing_summary
+{
+    uint64_t count;
+    int64_t t_min, t_max;
+    int32_t id_min, id_max;
+    double sum_sin_az, sum_cos_az;
+    double sum_el, sum_el2;
+    double sum_latency, sum_latency2;   // recv_stamp - stamp [s]
+
+    void clear();
+    void add(const bearing_record &r);
+    void merge(const bearing_summary &o);
+};
+
+struct bearing_block_header
+{
+    char magic[4];          // "BLK1"
+    uint32_t count;
+    uint32_t raw_size;
+    uint32_t comp_size;
+    bearing_summary summary;
+};
+
+struct bearing_index_entry
+{
+    uint64_t offset;        // of the block header
+    bearing_summary summary;
+};
+
+// Writes the log from a background thread. log() only copies the record
+// into a fixed ring and never blocks; records are dropped (and counted) if
+// the writer falls behind.
+class bearing_log_writer
+{
+public:
+    bearing_log_writer();
+    ~bearing_log_writer();
+
+    int open(const char *path);
+    void log(const bearing_record &r);
+    void close();
+
+    bool is_open() const { return fd_ >= 0; }
+
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> dropped_;
+
+private:
+    void run();
+    void flush_block();
+
+    int fd_ = -1;
+    uint64_t offset_ = 0;
+    // a partly written block could not be cut off again; nothing more is
+    // appended, so the blocks before it stay readable
+    bool failed_ = false;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+
+    // single producer, single consumer ring
+    bearing_record *queue_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+
+    // column buffers of the block being filled
+    bearing_record *block_;
+    uint32_t block_len_ = 0;
+    std::vector<unsigned char> raw_;
+    std::vector<unsigned char> comp_;
+    std::vector<bearing_index_entry> index_;
+};
+
+// Memory maps a log and decodes only the blocks a query touches.
+class bearing_log_reader
+{
+public:
+    bearing_log_reader() {}
+    ~bearing_log_reader();
+
+    int open(const char *path);
+    void close();
+
+    size_t blocks() const { return index_.size(); }
+    // bytes of the whole file
+    size_t size() const { return size_; }
+    const bearing_index_entry &block(size_t i) const { return index_[i]; }
+    bool indexed() const { return indexed_; }
+    // block time ranges never go backwards; queries of a log where they do
+    // visit every block
+    bool monotonic() const { return monotonic_; }
+
+    // decode block i into out; returns the number of records or -1
+    int read_block(size_t i, std::vector<bearing_record> &out) const;
+
+    // first block whose time range ends at or after t [ns]; 0 unless
+    // monotonic()
+    size_t lower_bound(int64_t t) const;
+
+    // call f(const bearing_record &) for every record with t0 <= stamp <= t1
+    template <typename F>
+    uint64_t query(int64_t t0, int64_t t1, F f) const;
+
+    // summary of the records in [t0, t1]; blocks entirely inside the range
+    // use their stored sums and only the two edge blocks are decoded
+    bearing_summary stats(int64_t t0, int64_t t1) const;
+
+private:
+    int scan_blocks();
+    bool block_header(uint64_t offset, bearing_block_header &header) const;
+    void check_order();
+    bool overlaps(size_t i, int64_t t0, int64_t t1) const
+    {
+        return index_[i].summary.t_max >= t0 && index_[i].summary.t_min <= t1;
+    }
+
+    const unsigned char *map_ = nullptr;
+    size_t size_ = 0;
+    // end of the block data, where the index starts
+    uint64_t data_end_ = 0;
+    bool indexed_ = false;
+    bool monotonic_ = true;
+    std::vector<bearing_index_entry> index_;
+};
+
+
+template <typename F>
+uint64_t bearing_log_reader::query(int64_t t0, int64_t t1, F f) const
+{
+    std::vector<bearing_record> records;
+    uint64_t n = 0;
+
+    for (size_t i = lower_bound(t0); i < index_.size(); i++)
+    {
+        if (!overlaps(i, t0, t1))
+        {
+            if (monotonic_ && index_[i].summary.t_min > t1)
+                break;
+            continue;
+        }
+        if (read_block(i, records) < 0)
+            break;
+        for (size_t j = 0; j < records.size(); j++)
+        {
+            if (records[j].stamp < t0 || records[j].stamp > t1)
+                continue;
+            f(records[j]);
+            n++;
+        }
+    }
+    return n;
+}
+
+#endif // BEARING_LOG_H
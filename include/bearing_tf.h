@@ -0,0 +1,63 @@
+#ifndef BEARING_TF_H
+#define BEARING_TF_H
+
+#include <string>
+#include <math.h>
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Vector3.h>
+#include "geometry_msgs/Vector3Stamped.h"
+
+// Origin and unit direction in target_frame of a bearing published on
+// rfdf_direction. The transform at the stamp of the bearing is waited for
+// up to timeout; if it has not arrived by then the newest one is used and
+// latest is set, off by however far the array moved since. Returns false,
+// with the reason in error, if TF cannot place the array at all.
+inline bool bearing_in_frame(const tf2_ros::Buffer &tf, const std::string &target_frame,
+                             const geometry_msgs::Vector3Stamped &bearing,
+                             const ros::Duration &timeout, double origin[3], double dir[3],
+                             bool &latest, std::string &error)
+{
+    geometry_msgs::TransformStamped t;
+    latest = false;
+    try
+    {
+        t = tf.lookupTransform(target_frame, bearing.header.frame_id, bearing.header.stamp,
+                               timeout);
+    }
+    catch (tf2::TransformException &ex)
+    {
+        try
+        {
+            t = tf.lookupTransform(target_frame, bearing.header.frame_id, ros::Time(0));
+        }
+        catch (tf2::TransformException &ex)
+        {
+            error = ex.what();
+            return false;
+        }
+        latest = true;
+        error = ex.what();
+    }
+
+    const geometry_msgs::Quaternion &r = t.transform.rotation;
+    tf2::Vector3 d = tf2::quatRotate(tf2::Quaternion(r.x, r.y, r.z, r.w),
+                                     tf2::Vector3(bearing.vector.x, bearing.vector.y, bearing.vector.z));
+    double len = sqrt(d.x() * d.x() + d.y() * d.y() + d.z() * d.z());
+    if (len < 1e-9)
+    {
+        error = "zero length bearing";
+        return false;
+    }
+
+    origin[0] = t.transform.translation.x;
+    origin[1] = t.transform.translation.y;
+    origin[2] = t.transform.translation.z;
+    dir[0] = d.x() / len;
+    dir[1] = d.y() / len;
+    dir[2] = d.z() / len;
+    return true;
+}
+
+#endif // BEARING_TF_H
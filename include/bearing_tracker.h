@@ -0,0 +1,108 @@
+#ifndef BEARING_TRACKER_H
+#define BEARING_TRACKER_H
+
+#include <stdint.h>
+
+// Constant rate Kalman tracker over the bearings of one device.
+//
+// Azimuth and elevation are tracked independently, each as angle and rate
+// driven by white noise acceleration. Azimuth innovations are wrapped to
+// +-180 degrees and the azimuth state itself is left unwrapped, so a
+// target crossing north neither jumps nor drags the rate. The whole state
+// fits in a tracker_state, and extrapolating it to any time is a handful
+// of multiplications: tracker_predict() is what both the node and the
+// shared memory readers call, so a controller can ask for the bearing at
+// the moment of actuation rather than at the last frame.
+
+// one angle and its rate with their covariance
+struct tracker_axis
+{
+    double angle;           // [deg]
+    double rate;            // [deg/s]
+    double p_aa, p_ar, p_rr;
+};
+
+// everything needed to extrapolate; also the shared memory record
+struct tracker_state
+{
+    double stamp;           // time of the last update [s]
+    double accel_noise;     // acceleration spectral density [deg^2/s^3]
+    tracker_axis azimuth;
+    tracker_axis elevation;
+    uint32_t updates;       // 0 until the first frame
+    uint32_t resets;
+};
+
+struct bearing_prediction
+{
+    double azimuth;         // [deg], 0 to 360
+    double elevation;       // [deg]
+    double azimuth_rate;    // [deg/s]
+    double elevation_rate;
+    double azimuth_cov[4];  // (angle, rate), row major
+    double elevation_cov[4];
+    double age;             // prediction time minus the last update [s]
+};
+
+// extrapolate s to time t; false if s has no update yet. States are
+// stamped in ROS time (rfdf_node stamps frames with ros::Time::now()), so
+// t must be ROS time too, which under /use_sim_time is the simulated
+// clock rather than the wall clock
+bool tracker_predict(const tracker_state &s, double t, bearing_prediction &p);
+
+class bearing_tracker
+{
+public:
+    // accel_noise is the process noise in deg^2/s^3, bearing_sigma the
+    // measurement noise in degrees; after a gap longer than timeout seconds,
+    // or the clock jumping back by more than that, the track restarts from
+    // the next frame
+    bearing_tracker(double accel_noise = 100.0, double bearing_sigma = 2.0, double timeout = 1.0);
+
+    void update(double stamp, float azimuth, float elevation);
+    bool predict(double t, bearing_prediction &p) const { return tracker_predict(state_, t, p); }
+    void reset();
+
+    const tracker_state &state() const { return state_; }
+
+    // frames older than the last update by less than the timeout, ignored
+    uint64_t out_of_order_ = 0;
+
+private:
+    void start(double stamp, float azimuth, float elevation);
+
+    tracker_state state_;
+    double r_;
+    double timeout_;
+};
+
+// The tracker_state of a device in /dev/shm/rfdf_track_<device>, guarded
+// by a sequence counter. The node publishes after every batch; readers
+// take a consistent copy without locking and extrapolate it themselves.
+class tracker_shm
+{
+public:
+    tracker_shm() {}
+    ~tracker_shm();
+
+    // writer side; a negative device keeps the block private to the process
+    int create(int device);
+    // reader side
+    int open(int device);
+    void close();
+    bool is_open() const { return shm_ != nullptr; }
+
+    void publish(const tracker_state &s);
+    // consistent copy of the latest state; false if none was published, or
+    // if the writer died halfway through a publish
+    bool read(tracker_state &s) const;
+    bool predict(double t, bearing_prediction &p) const;
+
+private:
+    struct block;
+    int map(int device, int flags);
+
+    block *shm_ = nullptr;
+};
+
+#endif // BEARING_TRACKER_H
@@ -0,0 +1,48 @@
+#ifndef CIRCULAR_FILTER_H
+#define CIRCULAR_FILTER_H
+
+#include <stdint.h>
+
+// largest sliding window supported by circular_filter
+#define CIRCULAR_FILTER_MAX_WINDOW 256
+
+// Sliding-window circular mean and variance of an angle in degrees.
+//
+// Running sums of sin and cos over the window give the mean direction in
+// O(1) per sample and handle the 0/360 wrap correctly. The circular
+// variance is 1 - R, where R is the mean resultant length (0 for a steady
+// bearing, 1 for bearings spread uniformly around the circle). Samples
+// further than the gate from the current mean can optionally be rejected.
+class circular_filter
+{
+public:
+    circular_filter(int window = 10, double gate = 0);
+
+    // add a sample [deg]; returns false if the sample was gated out
+    bool update(double deg);
+    void reset();
+    void configure(int window, double gate);
+
+    double mean() const;        // [deg], in [0, 360)
+    double variance() const;    // 1 - R, in [0, 1]
+    int count() const { return count_; }
+
+    uint64_t gated_ = 0;
+
+private:
+    void resum();
+
+    int window_;
+    double gate_;
+
+    double sin_[CIRCULAR_FILTER_MAX_WINDOW];
+    double cos_[CIRCULAR_FILTER_MAX_WINDOW];
+    int head_ = 0;
+    int count_ = 0;
+    double sum_sin_ = 0;
+    double sum_cos_ = 0;
+    int since_resum_ = 0;
+    int consecutive_gated_ = 0;
+};
+
+#endif // CIRCULAR_FILTER_H
@@ -0,0 +1,56 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdint.h>
+
+// Online mapping from the Gizmo frame counter to host time.
+//
+// The Gizmo only sends a frame id, so the receive time of a frame is its
+// sample time plus USB, tty and scheduler latency. This fits
+// recv_time = offset + period * id with exponentially weighted least
+// squares, gates residuals that are far from the fit, and tracks the lower
+// envelope of the residuals so the recovered stamps sit at the minimum
+// observed latency rather than the mean. Every update is O(1) and the
+// object never allocates.
+class clock_sync
+{
+public:
+    clock_sync(double half_life = 500.0, double gate = 4.0, int warmup = 20);
+
+    // feed one frame; returns the estimated sample time in seconds
+    double update(int64_t id, double recv_time);
+    // estimated sample time of a frame id, or -1 if not yet locked
+    double sample_time(int64_t id) const;
+    void reset();
+
+    bool locked() const { return accepted_ >= warmup_; }
+    double period() const { return slope_; }
+    double residual_sigma() const;
+
+    uint64_t accepted_ = 0;
+    uint64_t rejected_ = 0;
+    uint64_t resets_ = 0;
+
+private:
+    void solve();
+    void recenter(int64_t id);
+
+    double lambda_;
+    double gate_;
+    uint64_t warmup_;
+
+    // origin of the regression, moved forward to keep the sums small
+    bool have_origin_ = false;
+    int64_t id0_ = 0;
+    double t0_ = 0;
+    int64_t last_id_ = 0;
+
+    // exponentially weighted sums of x = id - id0 and y = t - t0
+    double sw_ = 0, sx_ = 0, sy_ = 0, sxx_ = 0, sxy_ = 0;
+    double slope_ = 0, intercept_ = 0;
+    double resid_var_ = 0;
+    double floor_ = 0;
+    int consecutive_rejects_ = 0;
+};
+
+#endif // CLOCK_SYNC_H
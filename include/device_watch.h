@@ -0,0 +1,36 @@
+#ifndef DEVICE_WATCH_H
+#define DEVICE_WATCH_H
+
+#include <limits.h>
+
+// Waits for a device node (or a /dev/serial/by-id symlink) to appear.
+//
+// inotify watches the deepest existing directory on the device path, so a
+// missing /dev/serial/by-id directory is handled by watching /dev/serial
+// (or /dev) until udev recreates it. Creation and permission changes wake
+// the waiter immediately; a slow periodic retry covers anything inotify
+// does not report.
+class device_watch
+{
+public:
+    device_watch() {}
+    ~device_watch();
+
+    int watch(const char *path);
+    // returns 1 once the path may be opened again, 0 on timeout, -1 on error
+    int wait(int timeout_ms);
+    // the path was there but failed to open (EACCES before udev applies its
+    // permissions, EBUSY); the next wait() waits for an event or its timeout
+    void backoff() { backoff_ = true; }
+    void close();
+
+private:
+    int arm();
+
+    char path_[PATH_MAX];
+    int fd_ = -1;
+    int wd_ = -1;
+    bool backoff_ = false;
+};
+
+#endif // DEVICE_WATCH_H
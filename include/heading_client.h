@@ -0,0 +1,56 @@
+#ifndef HEADING_CLIENT_H
+#define HEADING_CLIENT_H
+
+// Client side of the heading service. The service keeps the latest heading
+// in a small shared memory block (/dev/shm/heading) guarded by a sequence
+// counter, and wakes waiting clients through a futex on that counter, so a
+// client sleeps until an update arrives instead of polling the FIFO.
+//
+//   heading_open();
+//   while (heading_wait_next(&h, 1000) == 0)
+//       printf("%f %f\n", h.azimuth, h.elevation);
+//
+// Usable from C and C++. Functions return 0 on success and -1 with errno
+// set otherwise (ETIMEDOUT when a wait times out, ENOENT if the service
+// has never run).
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct heading_sample
+{
+    float azimuth;      // [deg]
+    float elevation;    // [deg]
+    double stamp;       // wall clock time the service received it [s]
+    uint32_t seq;       // increases by one per update
+};
+
+typedef void (*heading_callback)(const struct heading_sample *sample, void *arg);
+
+// map the service's shared heading
+int heading_open(void);
+void heading_close(void);
+
+// latest heading without waiting; fails with EAGAIN if none arrived yet,
+// EBUSY if the service stopped in the middle of an update
+int heading_get_latest(struct heading_sample *sample);
+
+// sleep until a heading newer than the last one returned arrives, at most
+// timeout_ms (forever if negative)
+int heading_wait_next(struct heading_sample *sample, int timeout_ms);
+
+// call cb from a background thread for every update; NULL stops it
+int heading_set_callback(heading_callback cb, void *arg);
+
+// service side: create the shared heading and publish updates to it
+int heading_publisher_open(void);
+void heading_publish(float azimuth, float elevation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEADING_CLIENT_H
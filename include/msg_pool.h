@@ -0,0 +1,49 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include <stdint.h>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+// Fixed set of preallocated messages handed out round robin, so publishing
+// does not construct a message per frame. A message is reused only once
+// nothing else holds it, i.e. roscpp has dropped its reference after an
+// intraprocess delivery; if every message is still held a new one is
+// allocated in its place and counted in misses_. Callers overwrite every
+// field; assigning a string of the same length reuses its storage.
+//
+// This saves constructing the message only. roscpp still allocates a
+// serialization buffer in every publish() that has a remote subscriber,
+// and the rarely sent std_msgs topics (signal, channel, health) build a
+// message per sentence, so publishing as a whole is not allocation free.
+template <typename M, int N>
+class msg_pool
+{
+public:
+    msg_pool()
+    {
+        for (int i = 0; i < N; i++)
+            msgs_[i] = boost::make_shared<M>();
+    }
+
+    const boost::shared_ptr<M> &next()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            next_ = next_ + 1 < N ? next_ + 1 : 0;
+            if (msgs_[next_].unique())
+                return msgs_[next_];
+        }
+        misses_++;
+        msgs_[next_] = boost::make_shared<M>();
+        return msgs_[next_];
+    }
+
+    uint64_t misses_ = 0;
+
+private:
+    boost::shared_ptr<M> msgs_[N];
+    int next_ = 0;
+};
+
+#endif // MSG_POOL_H
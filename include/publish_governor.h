@@ -0,0 +1,69 @@
+#ifndef PUBLISH_GOVERNOR_H
+#define PUBLISH_GOVERNOR_H
+
+#include <stdint.h>
+
+// how many of the parsed frames reach the publishers
+enum publish_policy
+{
+    PUBLISH_ALL,        // every frame, in batches per read
+    PUBLISH_DECIMATE,   // every Nth frame
+    PUBLISH_LATEST,     // newest frame only, at most once per period
+    PUBLISH_AUTO        // pick one of the above from the measured cost
+};
+
+// Backpressure between the parser and the publishers.
+//
+// The node reports how long its publish calls took per published frame,
+// not counting work it does for every frame anyway. In PUBLISH_AUTO
+// mode a moving average above latency_high steps the policy down from ALL
+// to DECIMATE to LATEST, and one below latency_low steps it back up, with
+// a hold of a few batches between switches so it does not flap. A change
+// in the number of subscribers restarts from ALL, since the cost of a
+// publish scales with them. Nothing is published without subscribers.
+//
+// Logging and smoothing see every frame regardless; only publishing is
+// governed.
+class publish_governor
+{
+public:
+    publish_governor() {}
+
+    void configure(publish_policy policy, int decimate = 4, double latest_period = 0.1,
+                   double latency_high = 2e-4, double latency_low = 5e-5);
+
+    // start of a batch; false if nothing of it is to be published
+    bool begin(int subscribers, double now);
+    // whether frame i of the n frames of the batch is published
+    bool admit(int i, int n);
+    // publishing m frames of the batch took seconds
+    void published(int m, double seconds);
+
+    // policy in effect for the current batch
+    publish_policy policy() const { return current_; }
+    static const char *name(publish_policy policy);
+
+    double latency() const { return latency_; }
+
+    uint64_t dropped_ = 0;      // frames not published
+    uint64_t switches_ = 0;     // automatic policy changes
+
+private:
+    void set(publish_policy policy);
+
+    publish_policy mode_ = PUBLISH_AUTO;
+    publish_policy current_ = PUBLISH_ALL;
+    int decimate_ = 4;
+    double latest_period_ = 0.1;
+    double latency_high_ = 2e-4;
+    double latency_low_ = 5e-5;
+
+    double now_ = 0;
+    double last_latest_ = 0;
+    uint64_t count_ = 0;
+    int subscribers_ = -1;
+    double latency_ = 0;
+    int hold_ = 0;
+};
+
+#endif // PUBLISH_GOVERNOR_H
@@ -5,19 +5,46 @@
 #include <time.h>
 #include <ros/ros.h>
 #include "geometry_msgs/Vector3Stamped.h"
+#include "std_msgs/Float32.h"
+#include "std_msgs/UInt8.h"
+#include "std_msgs/UInt32.h"
+#include "rfdf_core.h"
+#include "circular_filter.h"
+#include "trig_table.h"
+#include "bearing_log.h"
+#include "msg_pool.h"
+#include "tx_scheduler.h"
+#include "publish_governor.h"
+#include "udp_sink.h"
+#include "bearing_tracker.h"
+#include "tracker_service.h"
+#include "rfdf_reconfigure.h"
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <tf2/LinearMath/Quaternion.h>
 
 #include <string.h>
 #include <termios.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #define BUF_SIZE 100
+// largest ~read_size
+#define RFDF_READ_MAX 4096
+// most frames handled as one batch, ~max_batch can lower it
+#define RFDF_MAX_BATCH 32
+// preallocated messages per topic
+#define RFDF_MSG_POOL 8
 
 using namespace std;
 
@@ -25,24 +52,108 @@ class rfdf
 {
 public:
     rfdf();
-    void process_serial_data(char *buf, int cr);
-    void serial_sleep(int milliseconds);
+    void process_serial_data(char *buf, int cr, const ros::Time &stamp);
     void main_loop();
     void test_transmit_loop();
     void configure_serial();
+    bool wait_for_device();
     void send_data_serial(float elevation, float azimuth, int id);
     void parse_options(int argc, char** argv);
-    void ros_publish(float el, float az, int id);
+    void ros_publish(const rfdf_frame &frame);
+    void smooth_and_publish(const rfdf_frame &frame, bool publish = true);
+    void publish_batch(const rfdf_frame *frames, int n);
+    void transform_batch(const rfdf_frame *frames, int n);
+    void apply_settings(const rfdf_settings &s);
 
     int buf_size_ = 100;
-    char* device;
+    std::string device;
     int run_test_flag = 0;
     int device_flag = 0;
-    int tty_fd;
 
 private:
+    bool lookup_rotation(const ros::Time &stamp, tf2::Quaternion &q);
+    // subscribers over all topics the node publishes
+    int subscribers() const;
+    // next free message of pool, stamped for frame in frame_id
+    const geometry_msgs::Vector3Stamped::Ptr &
+    next_msg(msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> &pool,
+             const rfdf_frame &frame, const std::string &frame_id);
+
     ros::NodeHandle nh_;
     ros::Publisher rfdf_pub_;
+    ros::Publisher smoothed_pub_;
+    ros::Publisher variance_pub_;
+    ros::Publisher direction_pub_;
+    ros::Publisher world_pub_;
+    ros::Publisher signal_pub_;
+    ros::Publisher channel_pub_;
+    ros::Publisher health_pub_;
+
+    // messages are reused so the steady state publishes without allocating
+    msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> rfdf_msgs_;
+    msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> smoothed_msgs_;
+    msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> variance_msgs_;
+    msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> direction_msgs_;
+    msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> world_msgs_;
+
+    // serial port, framing, parsing and sample time recovery
+    rfdf_receiver receiver_;
+
+    // sensor frame of the array, used to look up its pose in TF
+    std::string frame_id_;
+
+    // publish unit bearing vectors next to the raw angles
+    bool direction_;
+
+    // frames decoded from one read, published together
+    rfdf_frame batch_[RFDF_MAX_BATCH];
+    int batch_len_ = 0;
+
+    // frames of the batch the governor let through, and the governor
+    rfdf_frame selected_[RFDF_MAX_BATCH];
+    publish_governor governor_;
+    // seconds spent in publish calls for the current batch
+    double publish_time_ = 0;
+
+    // optional output of bearings rotated into target_frame_
+    std::string target_frame_;
+    tf2_ros::Buffer tf_buffer_;
+    tf2_ros::TransformListener tf_listener_;
+    // lookups answered with the newest transform instead of the frame's own
+    uint64_t tf_fallbacks_ = 0;
+
+    // optional columnar log of every parsed bearing
+    bearing_log_writer log_;
+    int device_id_;
+
+    // trace dump written when the main loop ends, empty when not tracing
+    std::string trace_file_;
+
+    // optional UDP output of every parsed bearing for non-ROS consumers
+    udp_sink udp_;
+
+    // optional sliding-window smoothing of the bearings
+    bool smoothing_;
+    circular_filter el_filter_;
+    circular_filter az_filter_;
+
+    // live tunables: those in effect, and the latest from dynamic_reconfigure
+    // waiting for the read loop to pick them up
+    rfdf_settings settings_;
+    rfdf_settings pending_settings_;
+    // I/O backend last asked for; settings_ holds the one actually in use
+    std::string io_requested_;
+    std::mutex settings_mutex_;
+    std::atomic<bool> settings_changed_;
+    rfdf_reconfigure reconfigure_;
+
+    // optional rate tracker, shared through /dev/shm and ~predict_bearing,
+    // which the spinner thread serves beside the read loop
+    bool tracking_;
+    bearing_tracker tracker_;
+    tracker_shm tracker_shm_;
+    tracker_service tracker_service_;
+    ros::AsyncSpinner spinner_;
 
 };
 
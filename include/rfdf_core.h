@@ -0,0 +1,96 @@
+#ifndef RFDF_CORE_H
+#define RFDF_CORE_H
+
+// ROS independent rfdf receiver: serial setup, framing, parsing and sample
+// time recovery. The rfdf_node is a thin ROS adapter on top of this; other
+// programs can link rfdf_core and decode bearings in-process.
+
+#include "rfdf_serial.h"
+#include "rfdf_parser.h"
+#include "clock_sync.h"
+#include "device_watch.h"
+#include "rfdf_io.h"
+
+// host wall clock in seconds, the same time base as ros::Time::now()
+double rfdf_now();
+
+class rfdf_receiver
+{
+public:
+    rfdf_receiver() {}
+    ~rfdf_receiver() { delete io_; }
+
+    // select how the port is waited on: "sleep", "epoll", "hybrid" or "uring";
+    // may be called while the port is open, the new backend takes it over
+    void set_io(const char *mode, int spin_us = RFDF_IO_SPIN_US, int sleep_us = RFDF_IO_SLEEP_US);
+
+    int open(const char *device, speed_t baud = B115200);
+    // change the line speed of the open port, and of later reconnects
+    int set_baud(speed_t baud);
+    void close() { port_.close(); parser_.reset(); }
+
+    // close the port after the device went away and count the outage
+    void lost();
+    // wait up to timeout_ms for the device to reappear and reopen it;
+    // returns 0 once the port is open again, -1 otherwise
+    int reconnect(int timeout_ms);
+    // length of the last completed outage [s]
+    double last_outage() const { return last_outage_; }
+
+    // wait up to timeout_ms for data, read it and decode any complete
+    // frames; returns the number of bytes read, 0 if none, -1 on error
+    template <typename F>
+    ssize_t receive(F on_frame, int timeout_ms = 0);
+
+    // decode bytes that were read elsewhere
+    template <typename F>
+    size_t decode(const char *buf, size_t len, double recv_stamp, F on_frame);
+
+    const rfdf_stats &stats() const { return parser_.stats_; }
+
+    serial_port port_;
+    rfdf_parser parser_;
+    clock_sync clock_;
+    bool clock_sync_enabled_ = true;
+    rfdf_io *io_ = nullptr;
+
+private:
+    void attach_io();
+
+    char buf_[RFDF_LINE_SIZE];
+
+    char device_[PATH_MAX];
+    speed_t baud_ = B115200;
+    device_watch watch_;
+    double lost_stamp_ = 0;
+    double last_outage_ = 0;
+};
+
+
+template <typename F>
+ssize_t rfdf_receiver::receive(F on_frame, int timeout_ms)
+{
+    RFDF_TRACE(TRACE_READ_ENTER, 0, 0);
+    ssize_t cr = io_ ? io_->read(buf_, sizeof(buf_), timeout_ms) : port_.read(buf_, sizeof(buf_));
+    RFDF_TRACE(TRACE_READ_EXIT, cr, 0);
+    if (cr > 0)
+        decode(buf_, cr, rfdf_now(), on_frame);
+    else if (cr < 0)
+        parser_.stats_.read_errors++;
+    return cr;
+}
+
+template <typename F>
+size_t rfdf_receiver::decode(const char *buf, size_t len, double recv_stamp, F on_frame)
+{
+    parser_.stats_.reads++;
+    return parser_.feed(buf, len, recv_stamp, [&](rfdf_frame &frame)
+    {
+        if (clock_sync_enabled_)
+            frame.stamp = clock_.update(frame.id, frame.recv_stamp);
+        RFDF_TRACE(TRACE_FRAME, frame.id, (int64_t)((frame.recv_stamp - frame.stamp) * 1e9));
+        on_frame(frame);
+    });
+}
+
+#endif // RFDF_CORE_H
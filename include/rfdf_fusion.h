@@ -0,0 +1,48 @@
+#ifndef RFDF_FUSION_H
+#define RFDF_FUSION_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include "geometry_msgs/Vector3Stamped.h"
+#include "geometry_msgs/PointStamped.h"
+#include "bearing_fusion.h"
+
+using namespace std;
+
+// Triangulates the emitter from the rfdf_direction bearings of several
+// arrays. The pose of every array comes from TF through the frame_id of
+// its bearings.
+class rfdf_fusion
+{
+public:
+    rfdf_fusion();
+    void bearing_callback(const geometry_msgs::Vector3Stamped::ConstPtr &msg);
+
+private:
+    ros::NodeHandle nh_;
+    ros::Publisher fix_pub_;
+    vector<ros::Subscriber> bearing_subs_;
+
+    tf2_ros::Buffer tf_buffer_;
+    tf2_ros::TransformListener tf_listener_;
+    // wait for the transform at a bearing's stamp, then take the newest
+    ros::Duration tf_timeout_;
+    // bearings placed with the newest transform, and those TF could not place
+    uint64_t tf_fallbacks_ = 0;
+    uint64_t tf_drops_ = 0;
+
+    string world_frame_;
+    double max_age_;
+    int min_arrays_;
+
+    bearing_fusion fusion_;
+    // newest bearing stamp of each array, by frame_id
+    map<string, ros::Time> last_bearing_;
+    ros::Time newest_;
+};
+
+#endif // RFDF_FUSION_H
@@ -0,0 +1,46 @@
+#ifndef RFDF_GRID_H
+#define RFDF_GRID_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include "geometry_msgs/Vector3Stamped.h"
+#include "nav_msgs/OccupancyGrid.h"
+#include "bearing_grid.h"
+
+using namespace std;
+
+// Accumulates rfdf_direction bearings into an emitter likelihood grid in
+// the world frame and publishes it as an OccupancyGrid at a fixed rate.
+class rfdf_grid
+{
+public:
+    rfdf_grid();
+    ~rfdf_grid() { delete grid_; }
+    void bearing_callback(const geometry_msgs::Vector3Stamped::ConstPtr &msg);
+    void publish_callback(const ros::TimerEvent &event);
+
+private:
+    ros::NodeHandle nh_;
+    ros::Publisher grid_pub_;
+    vector<ros::Subscriber> bearing_subs_;
+    ros::Timer publish_timer_;
+
+    tf2_ros::Buffer tf_buffer_;
+    tf2_ros::TransformListener tf_listener_;
+    // wait for the transform at a bearing's stamp, then take the newest
+    ros::Duration tf_timeout_;
+    // bearings placed with the newest transform, and those TF could not place
+    uint64_t tf_fallbacks_ = 0;
+    uint64_t tf_drops_ = 0;
+
+    string world_frame_;
+    bearing_grid *grid_;
+    nav_msgs::OccupancyGrid msg_;
+    ros::Time newest_;
+};
+
+#endif // RFDF_GRID_H
@@ -0,0 +1,134 @@
+#ifndef RFDF_IO_H
+#define RFDF_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// most writes queued between two flush() calls
+#define RFDF_IO_MAX_WRITES 32
+// longest single queued write
+#define RFDF_IO_WRITE_SIZE 128
+// default upper bound of the hybrid backend's spin window
+#define RFDF_IO_SPIN_US 200
+// default idle sleep of the sleep backend
+#define RFDF_IO_SLEEP_US 10000
+
+// How the serial port is waited on and read.
+//
+//   sleep   non-blocking read, then a sleep (10 ms by default) when
+//           nothing arrived (the original main loop)
+//   epoll   block in epoll_wait until the port is readable
+//   hybrid  spin on non-blocking reads for a short window after each
+//           frame, then block in epoll_wait once the link goes quiet
+//   uring   io_uring: a poll linked to a read is submitted and waited for
+//           in a single io_uring_enter, and queued writes go out in one
+//           submission
+//
+// Backends count their own system calls so they can be compared by
+// rfdf_bench.
+class rfdf_io
+{
+public:
+    virtual ~rfdf_io() {}
+
+    // start / stop serving a port; attach() is called again after a reconnect
+    virtual int attach(int fd) = 0;
+    virtual void detach() = 0;
+
+    // wait up to timeout_ms for data and read it; returns the number of
+    // bytes, 0 on timeout, -1 on error with errno set (EIO on hangup)
+    virtual ssize_t read(char *buf, size_t len, int timeout_ms) = 0;
+
+    // queue one write; flush() hands everything queued to the kernel at once
+    virtual int write(const char *buf, size_t len) = 0;
+    virtual int flush() = 0;
+
+    // stop reading ahead before the backend is replaced: a read still in
+    // flight is cancelled or completed, and later reads return only what
+    // was already received, then 0
+    virtual void cancel() {}
+
+    virtual const char *name() const = 0;
+
+    // backend named by mode, or the epoll backend if mode is unknown or
+    // io_uring is unavailable on this kernel; spin_us bounds the hybrid
+    // backend's spin window, sleep_us is the sleep backend's idle sleep
+    static rfdf_io *create(const char *mode, int spin_us = RFDF_IO_SPIN_US,
+                           int sleep_us = RFDF_IO_SLEEP_US);
+
+    uint64_t syscalls_ = 0;
+    uint64_t reads_ = 0;
+    uint64_t writes_ = 0;
+};
+
+class rfdf_io_sleep : public rfdf_io
+{
+public:
+    rfdf_io_sleep(int sleep_us = RFDF_IO_SLEEP_US) : sleep_us_(sleep_us) {}
+    int attach(int fd);
+    void detach();
+    ssize_t read(char *buf, size_t len, int timeout_ms);
+    int write(const char *buf, size_t len);
+    int flush() { return 0; }
+    const char *name() const { return "sleep"; }
+
+private:
+    int fd_ = -1;
+    int sleep_us_;
+};
+
+class rfdf_io_epoll : public rfdf_io
+{
+public:
+    ~rfdf_io_epoll();
+    int attach(int fd);
+    void detach();
+    ssize_t read(char *buf, size_t len, int timeout_ms);
+    int write(const char *buf, size_t len);
+    int flush();
+    const char *name() const { return "epoll"; }
+
+protected:
+    int fd_ = -1;
+    int epfd_ = -1;
+
+private:
+    char queue_[RFDF_IO_MAX_WRITES][RFDF_IO_WRITE_SIZE];
+    size_t queue_len_[RFDF_IO_MAX_WRITES];
+    int queued_ = 0;
+};
+
+// epoll with adaptive busy polling.
+//
+// The gap between frames is tracked like a TCP round trip time: a moving
+// average plus four mean deviations gives the spin window. After each
+// frame the reader spins on read() until the window has passed since the
+// last arrival, so frames inside a burst are picked up without a wake up.
+// When the typical gap is longer than the spin budget no spinning is done
+// at all, and an idle link costs nothing but an epoll_wait.
+class rfdf_io_hybrid : public rfdf_io_epoll
+{
+public:
+    rfdf_io_hybrid(int spin_us) : max_spin_(spin_us * 1e-6) {}
+
+    ssize_t read(char *buf, size_t len, int timeout_ms);
+    const char *name() const { return "hybrid"; }
+
+    // current spin window in seconds
+    double spin_window() const { return spin_; }
+
+    uint64_t spins_ = 0;      // reads served while spinning
+    uint64_t sleeps_ = 0;     // reads that fell back to epoll_wait
+
+private:
+    void arrived(double now);
+
+    double max_spin_;
+    double spin_ = 0;
+    double last_ = 0;
+    double gap_ = 0;
+    double gap_dev_ = 0;
+};
+
+#endif // RFDF_IO_H
@@ -0,0 +1,81 @@
+#ifndef RFDF_IO_URING_H
+#define RFDF_IO_URING_H
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "rfdf_io.h"
+
+// size of the kernel side read buffer
+#define RFDF_URING_READ_SIZE 256
+
+// io_uring backend talking to the kernel through the raw system calls, so
+// no liburing is needed.
+//
+// A POLL_ADD linked to a READ is queued for the port and submitted in the
+// same io_uring_enter that waits for its completion, so a wake up costs
+// one system call instead of epoll_wait plus read. Writes are copied into
+// fixed slots and flush() sends them as a single WRITEV, then waits for
+// it: only one write is ever in flight, so sentences go out in order and
+// never interleave. (Linking one WRITE per sentence would keep them apart
+// too, but tty writes issued from a link fail with EINTR on some kernels.)
+class rfdf_io_uring : public rfdf_io
+{
+public:
+    rfdf_io_uring() {}
+    ~rfdf_io_uring();
+
+    // true if this kernel lets us set up a ring with the features we use
+    static bool available();
+
+    int attach(int fd);
+    void detach();
+    ssize_t read(char *buf, size_t len, int timeout_ms);
+    int write(const char *buf, size_t len);
+    int flush();
+    void cancel();
+    const char *name() const { return "uring"; }
+
+private:
+    int setup();
+    void teardown();
+    struct io_uring_sqe *get_sqe();
+    int enter(unsigned wait_nr, int timeout_ms);
+    // handle completions; a read error is left in read_error_, a failed or
+    // short write in write_error_
+    void reap();
+
+    int fd_ = -1;
+    int ring_fd_ = -1;
+
+    void *sq_map_ = nullptr;
+    size_t sq_map_size_ = 0;
+    void *cq_map_ = nullptr;
+    size_t cq_map_size_ = 0;
+    struct io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_, *sq_tail_, *sq_mask_, *sq_array_;
+    unsigned *cq_head_, *cq_tail_, *cq_mask_;
+    struct io_uring_cqe *cqes_;
+    unsigned sq_entries_ = 0;
+    unsigned to_submit_ = 0;
+
+    // the in-flight poll + read pair and the data it returned
+    bool read_armed_ = false;
+    char read_buf_[RFDF_URING_READ_SIZE];
+    size_t read_len_ = 0;
+    size_t read_off_ = 0;
+    int read_error_ = 0;
+    // set by cancel(), no further reads are armed until the next attach()
+    bool read_stopped_ = false;
+
+    // queued writes, owned by the kernel while the WRITEV is in flight
+    char slots_[RFDF_IO_MAX_WRITES][RFDF_IO_WRITE_SIZE];
+    struct iovec iov_[RFDF_IO_MAX_WRITES];
+    int queued_ = 0;
+    size_t queued_bytes_ = 0;
+    bool write_armed_ = false;
+    int write_error_ = 0;
+};
+
+#endif // RFDF_IO_URING_H
@@ -0,0 +1,285 @@
+#ifndef RFDF_PARSER_H
+#define RFDF_PARSER_H
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include "sentence.h"
+#include "rfdf_trace.h"
+
+// longest sentence accepted from the Gizmo, including the newline
+#define RFDF_LINE_SIZE 100
+
+// Any sentence may end in an optional checksum, *HH after the ';': the
+// CRC-8 (polynomial 0x07) of every byte from the header up to and
+// including the ';', as two upper case hex digits.
+//   EAI000045.3,000170.3,0000000042;*3A
+enum rfdf_checksum
+{
+    CHECKSUM_NONE,
+    CHECKSUM_OK,
+    CHECKSUM_BAD
+};
+
+// one decoded EAI sentence
+struct rfdf_frame
+{
+    float elevation;
+    float azimuth;
+    int32_t id;
+    double recv_stamp;  // host time the bytes were read [s]
+    double stamp;       // estimated sample time [s]
+};
+
+// SIG<strength dBm>,<id>;  e.g. SIG-073.5,0000000042;
+struct rfdf_signal
+{
+    static const int type = SENTENCE_SIG;
+    static bool parse(const char *payload, rfdf_signal &s);
+
+    float strength;
+    int32_t id;
+    double recv_stamp;
+};
+
+// CHN<channel>;  e.g. CHN03;
+struct rfdf_channel
+{
+    static const int type = SENTENCE_CHN;
+    static bool parse(const char *payload, rfdf_channel &c);
+
+    int32_t channel;
+    double recv_stamp;
+};
+
+// HLT<flags>;  decimal bit field of the firmware's fault flags, 0 if healthy
+struct rfdf_health
+{
+    static const int type = SENTENCE_HLT;
+    static bool parse(const char *payload, rfdf_health &h);
+
+    uint32_t flags;
+    double recv_stamp;
+};
+
+struct rfdf_stats
+{
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t frames;
+    uint64_t parse_errors;
+    uint64_t overflows;
+    uint64_t read_errors;
+    uint64_t outages;
+    uint64_t unknown;       // lines with a header nobody handles
+    uint64_t checksum_errors;   // wrong checksum, or missing while required
+    uint64_t resyncs;       // sentences recovered from inside a bad line
+};
+
+// Splits the serial byte stream into lines and dispatches them by header,
+// see sentence.h. EAI sentences go to the on_frame callback of feed();
+// other sentences go to the typed handlers registered with on<T>(). Lines
+// may be split across reads; partial lines are carried over to the next
+// call to feed(). A line holding several sentences, because noise ate the
+// newlines between them, is decoded sentence by sentence. A sentence that
+// fails its checksum or does not parse is dropped and counted, then the
+// rest of the line is searched for the next header.
+class rfdf_parser
+{
+public:
+    rfdf_parser() { memset(&stats_, 0, sizeof(stats_)); }
+
+    // decode len bytes, calling on_frame(const rfdf_frame &) for every
+    // complete sentence; returns the number of frames decoded
+    template <typename F>
+    size_t feed(const char *buf, size_t len, double recv_stamp, F on_frame);
+
+    // call f(const T &) for every sentence of type T, where T is one of the
+    // sentence structs above
+    template <typename T, typename F>
+    void on(F f);
+
+    // decode a single NUL terminated line
+    static bool parse_line(const char *line, rfdf_frame &frame);
+    // decode the payload of an EAI sentence
+    static bool parse_eai(const char *payload, rfdf_frame &frame);
+    // verify the checksum of a line of len bytes, if it has one
+    static rfdf_checksum check(const char *line, size_t len);
+
+    void reset() { line_len_ = 0; discarding_ = false; }
+
+    rfdf_stats stats_;
+
+    // reject sentences without a checksum
+    bool require_checksum_ = false;
+
+private:
+    enum dispatch_result
+    {
+        DISPATCH_OK,
+        DISPATCH_UNKNOWN,
+        DISPATCH_PARSE_ERROR,
+        DISPATCH_CHECKSUM
+    };
+
+    // decode the sentence at the start of line, setting used to its length
+    template <typename F>
+    dispatch_result dispatch(const char *line, size_t len, double recv_stamp, F &on_frame,
+                             size_t &used);
+    // length of the sentence at the start of line: up to its ';' and the
+    // *HH behind it, or all of len without a ';'
+    static size_t sentence_length(const char *line, size_t len, size_t header_len);
+
+    char line_[RFDF_LINE_SIZE];
+    size_t line_len_ = 0;
+    bool discarding_ = false;
+
+    // handler per sentence type, given the payload; false on a parse error
+    std::function<bool (const char *, double)> handlers_[SENTENCE_TYPES];
+};
+
+// write the EAI sentence for one heading into buf, with a checksum if
+// asked for; returns its length
+int rfdf_encode(char *buf, size_t size, float elevation, float azimuth, int id,
+                bool checksum = false);
+
+// CRC-8, polynomial 0x07, initial value 0
+uint8_t rfdf_crc8(const char *buf, size_t len);
+
+
+template <typename F>
+size_t rfdf_parser::feed(const char *buf, size_t len, double recv_stamp, F on_frame)
+{
+    size_t frames = 0;
+    const char *end = buf + len;
+
+    stats_.bytes += len;
+    while (buf < end)
+    {
+        const char *nl = (const char *)memchr(buf, '\n', end - buf);
+        size_t n = (nl ? nl + 1 : end) - buf;
+
+        if (!discarding_)
+        {
+            if (line_len_ + n < RFDF_LINE_SIZE)
+            {
+                memcpy(line_ + line_len_, buf, n);
+                line_len_ += n;
+            }
+            else
+            {
+                // sentence longer than any valid frame: drop it up to the
+                // next newline
+                stats_.overflows++;
+                discarding_ = true;
+                line_len_ = 0;
+            }
+        }
+        buf += n;
+
+        if (!nl)
+            break;
+
+        if (!discarding_ && line_len_ > 1)
+        {
+            line_[line_len_] = '\0';
+            uint64_t before = stats_.frames;
+            const char *p = line_;
+            size_t left = line_len_;
+            bool resyncing = false;
+
+            while (left > 0)
+            {
+                size_t used = left;
+                dispatch_result r = dispatch(p, left, recv_stamp, on_frame, used);
+                if (r == DISPATCH_OK)
+                {
+                    if (resyncing)
+                        stats_.resyncs++;
+                    resyncing = false;
+                    // go on with whatever follows the sentence
+                    p += used;
+                    left -= used;
+                    while (left > 0 && isspace((unsigned char)*p))
+                    {
+                        p++;
+                        left--;
+                    }
+                    continue;
+                }
+
+                // the first failure counts, those while searching do not
+                if (!resyncing)
+                {
+                    if (r == DISPATCH_UNKNOWN)
+                        stats_.unknown++;
+                    else if (r == DISPATCH_CHECKSUM)
+                        stats_.checksum_errors++;
+                    else
+                        stats_.parse_errors++;
+                    if (r != DISPATCH_UNKNOWN)
+                        RFDF_TRACE(TRACE_PARSE_ERROR, line_len_, 0);
+                    resyncing = true;
+                }
+
+                // resync on the next header character; every one is tried,
+                // since the byte before it may be a letter of a checksum
+                size_t i = 1;
+                while (i < left && !sentence_header_char(p[i]))
+                    i++;
+                p += i;
+                left -= i;
+            }
+            frames += stats_.frames - before;
+        }
+        line_len_ = 0;
+        discarding_ = false;
+    }
+    return frames;
+}
+
+template <typename F>
+rfdf_parser::dispatch_result rfdf_parser::dispatch(const char *line, size_t len,
+                                                   double recv_stamp, F &on_frame,
+                                                   size_t &used)
+{
+    size_t header_len;
+    int type = sentence_lookup(line, len, &header_len);
+    if (type == SENTENCE_UNKNOWN || (type != SENTENCE_EAI && !handlers_[type]))
+        return DISPATCH_UNKNOWN;
+
+    used = sentence_length(line, len, header_len);
+    rfdf_checksum c = check(line, used);
+    if (c == CHECKSUM_BAD || (c == CHECKSUM_NONE && require_checksum_))
+        return DISPATCH_CHECKSUM;
+
+    if (type != SENTENCE_EAI)
+        return handlers_[type](line + header_len, recv_stamp) ? DISPATCH_OK : DISPATCH_PARSE_ERROR;
+
+    rfdf_frame frame;
+    if (!parse_eai(line + header_len, frame))
+        return DISPATCH_PARSE_ERROR;
+    frame.recv_stamp = recv_stamp;
+    frame.stamp = recv_stamp;
+    stats_.frames++;
+    on_frame(frame);
+    return DISPATCH_OK;
+}
+
+template <typename T, typename F>
+void rfdf_parser::on(F f)
+{
+    handlers_[T::type] = [f](const char *payload, double recv_stamp)
+    {
+        T sentence;
+        if (!T::parse(payload, sentence))
+            return false;
+        sentence.recv_stamp = recv_stamp;
+        f(sentence);
+        return true;
+    };
+}
+
+#endif // RFDF_PARSER_H
@@ -0,0 +1,45 @@
+#ifndef RFDF_RECONFIGURE_H
+#define RFDF_RECONFIGURE_H
+
+#include <functional>
+#include <string>
+#include <ros/ros.h>
+
+// the tunables of rfdf_node that can change while it runs, see cfg/Rfdf.cfg
+struct rfdf_settings
+{
+    std::string io_backend;
+    int busy_poll_us = 0;
+    int sleep_ms = 0;
+    int read_size = 0;
+    int max_batch = 0;
+    std::string overload_policy;
+    int decimate = 0;
+    double latest_period = 0;
+    double publish_latency_high = 0;
+    double publish_latency_low = 0;
+    int baud = 0;
+    std::string log_level;
+    bool echo_frames = false;
+};
+
+// dynamic_reconfigure server of the node's private namespace. Like
+// tracker_service.h this keeps the generated rfdf:: namespace out of the
+// translation unit of the node class.
+class rfdf_reconfigure
+{
+public:
+    typedef std::function<void (const rfdf_settings &)> callback;
+
+    ~rfdf_reconfigure();
+
+    // serve the settings; f runs on the spinner thread for every change,
+    // and once right away with the current parameters
+    void start(ros::NodeHandle &nh, callback f);
+
+private:
+    struct server;
+    server *server_ = nullptr;
+};
+
+#endif // RFDF_RECONFIGURE_H
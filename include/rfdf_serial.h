@@ -0,0 +1,35 @@
+#ifndef RFDF_SERIAL_H
+#define RFDF_SERIAL_H
+
+#include <termios.h>
+#include <sys/types.h>
+
+// Raw 8N1 serial port used to talk to the Gizmo. Errors are returned to the
+// caller (with errno set) instead of terminating the process.
+class serial_port
+{
+public:
+    serial_port() {}
+    ~serial_port();
+
+    int open(const char *device, speed_t baud = B115200);
+    int configure(speed_t baud);
+    void close();
+
+    // termios constant of a line speed in baud, or B0 if unsupported
+    static speed_t speed(int baud);
+
+    ssize_t read(void *buf, size_t len);
+    ssize_t write(const void *buf, size_t len);
+
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+private:
+    serial_port(const serial_port &);
+    serial_port &operator=(const serial_port &);
+
+    int fd_ = -1;
+};
+
+#endif // RFDF_SERIAL_H
@@ -0,0 +1,69 @@
+#ifndef RFDF_TRACE_H
+#define RFDF_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Static tracepoints along the read -> parse -> publish pipeline.
+//
+// Built with -DRFDF_TRACE_ENABLED (cmake -DRFDF_TRACE=ON) every
+// RFDF_TRACE() site checks one relaxed flag and, while tracing is started,
+// stores a timestamped record into a fixed in-memory ring; without it the
+// sites compile to nothing. rfdf_trace_stop() writes the ring to the file
+// given to rfdf_trace_start(), which scripts/rfdf_trace.py turns into
+// per-stage latencies. Where <sys/sdt.h> is available each site is also a
+// USDT probe (provider rfdf) for perf, bpftrace or SystemTap.
+
+enum rfdf_trace_event
+{
+    TRACE_READ_ENTER = 1,   // about to wait on the port
+    TRACE_READ_EXIT,        // a: bytes read, or -1
+    TRACE_FRAME,            // a: id, b: receive minus sample time [ns]
+    TRACE_PARSE_ERROR,      // a: line length
+    TRACE_ENQUEUE,          // a: id, handed to the log writer
+    TRACE_DEQUEUE,          // a: id, taken by the log writer thread
+    TRACE_PUBLISH_BEGIN,    // a: frames in the batch
+    TRACE_PUBLISH_END       // a: frames published
+};
+
+#define RFDF_TRACE_MAGIC "RFDFTRC1"
+
+// one record of the ring and of the trace file
+struct rfdf_trace_record
+{
+    uint64_t seq;
+    uint64_t t;             // CLOCK_MONOTONIC [ns]
+    uint32_t event;
+    uint32_t tid;
+    int64_t a;
+    int64_t b;
+};
+
+extern std::atomic<bool> rfdf_trace_on;
+
+// start recording into a ring of events records, rounded up to a power of
+// two; the trace is written to path by rfdf_trace_stop()
+int rfdf_trace_start(const char *path, size_t events = 1 << 20);
+int rfdf_trace_stop();
+void rfdf_trace_emit(uint32_t event, int64_t a, int64_t b);
+
+#ifdef RFDF_TRACE_ENABLED
+#ifdef RFDF_HAVE_SDT
+#include <sys/sdt.h>
+#define RFDF_TRACE_SDT(event, a, b) DTRACE_PROBE3(rfdf, trace, event, a, b)
+#else
+#define RFDF_TRACE_SDT(event, a, b) do {} while (0)
+#endif
+#define RFDF_TRACE(event, a, b) \
+    do \
+    { \
+        RFDF_TRACE_SDT(event, a, b); \
+        if (__builtin_expect(rfdf_trace_on.load(std::memory_order_relaxed), 0)) \
+            rfdf_trace_emit(event, a, b); \
+    } while (0)
+#else
+#define RFDF_TRACE(event, a, b) do {} while (0)
+#endif
+
+#endif // RFDF_TRACE_H
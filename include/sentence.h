@@ -0,0 +1,129 @@
+#ifndef SENTENCE_H
+#define SENTENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Every serial and FIFO sentence starts with a header of upper case
+// letters followed by its payload, e.g. "EAI0045.3,0170.2,0000000042;" or
+// "AZIMUTH170.3". Headers are looked up through a perfect hash whose seed
+// is searched at compile time, so a line costs one pass over its header,
+// one table load and one memcmp however many sentence types exist.
+//
+// Adding a sentence: append it to sentence_type and sentence_headers; the
+// build fails if no collision free seed is found for the table size.
+
+enum sentence_type
+{
+    SENTENCE_UNKNOWN = -1,
+
+    // Gizmo -> receiver
+    SENTENCE_EAI,        // elevation, azimuth, id
+    SENTENCE_SIG,        // signal strength
+    SENTENCE_CHN,        // channel
+    SENTENCE_HLT,        // health flags
+
+    // heading service FIFO and serial link
+    SENTENCE_AZIMUTH,
+    SENTENCE_ELEVATION,
+    SENTENCE_SEND,
+    SENTENCE_KILL,
+
+    SENTENCE_TYPES
+};
+
+static constexpr const char *sentence_headers[SENTENCE_TYPES] =
+{
+    "EAI", "SIG", "CHN", "HLT",
+    "AZIMUTH", "ELEVATION", "SEND", "K",
+};
+
+// power of two, at least twice the number of sentence types
+#define SENTENCE_TABLE_SIZE 32
+
+
+constexpr bool sentence_header_char(char c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+// FNV-1a over the header bytes, with a searched seed as offset basis
+constexpr uint32_t sentence_hash_step(uint32_t h, char c)
+{
+    return (h ^ (uint8_t)c) * 16777619u;
+}
+
+constexpr uint32_t sentence_hash_slot(uint32_t h)
+{
+    return (h ^ (h >> 15)) & (SENTENCE_TABLE_SIZE - 1);
+}
+
+constexpr uint32_t sentence_slot(const char *header, uint32_t seed)
+{
+    uint32_t h = seed;
+    while (*header)
+        h = sentence_hash_step(h, *header++);
+    return sentence_hash_slot(h);
+}
+
+constexpr bool sentence_seed_ok(uint32_t seed)
+{
+    bool used[SENTENCE_TABLE_SIZE] = {};
+    for (int t = 0; t < SENTENCE_TYPES; t++)
+    {
+        uint32_t slot = sentence_slot(sentence_headers[t], seed);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t sentence_find_seed()
+{
+    uint32_t seed = 2166136261u;
+    for (int i = 0; i < 1000; i++, seed++)
+        if (sentence_seed_ok(seed))
+            return seed;
+    return 0;
+}
+
+struct sentence_table
+{
+    int8_t type[SENTENCE_TABLE_SIZE];
+};
+
+constexpr sentence_table sentence_build_table(uint32_t seed)
+{
+    sentence_table table = {};
+    for (int i = 0; i < SENTENCE_TABLE_SIZE; i++)
+        table.type[i] = SENTENCE_UNKNOWN;
+    for (int t = 0; t < SENTENCE_TYPES; t++)
+        table.type[sentence_slot(sentence_headers[t], seed)] = t;
+    return table;
+}
+
+static constexpr uint32_t sentence_seed = sentence_find_seed();
+static_assert(sentence_seed != 0, "no perfect hash seed for the sentence headers");
+static constexpr sentence_table sentence_slots = sentence_build_table(sentence_seed);
+
+
+// type of the sentence starting at line, or SENTENCE_UNKNOWN; the payload
+// starts header_len bytes into the line
+inline int sentence_lookup(const char *line, size_t len, size_t *header_len)
+{
+    uint32_t h = sentence_seed;
+    size_t n = 0;
+    while (n < len && sentence_header_char(line[n]))
+        h = sentence_hash_step(h, line[n++]);
+
+    int t = sentence_slots.type[sentence_hash_slot(h)];
+    if (t == SENTENCE_UNKNOWN || n == 0 || memcmp(sentence_headers[t], line, n) ||
+        sentence_headers[t][n] != '\0')
+        return SENTENCE_UNKNOWN;
+    *header_len = n;
+    return t;
+}
+
+#endif // SENTENCE_H
@@ -0,0 +1,25 @@
+#ifndef TRACKER_SERVICE_H
+#define TRACKER_SERVICE_H
+
+#include <string>
+#include <ros/ros.h>
+#include "bearing_tracker.h"
+
+// The PredictBearing service of rfdf_node, answered from the tracker's
+// shared memory block so it can run on a spinner thread next to the read
+// loop. Kept out of rfdf.h: the generated rfdf:: service namespace would
+// clash with the node class of the same name.
+class tracker_service
+{
+public:
+    ~tracker_service();
+
+    void advertise(ros::NodeHandle &nh, const std::string &name, const tracker_shm *shm);
+
+private:
+    struct handler;
+    handler *handler_ = nullptr;
+    ros::ServiceServer server_;
+};
+
+#endif // TRACKER_SERVICE_H
@@ -0,0 +1,17 @@
+#ifndef TRIG_TABLE_H
+#define TRIG_TABLE_H
+
+// sin/cos lookup at the 0.1 degree resolution of the EAI sentence
+#define TRIG_TABLE_STEPS 3600
+
+// sine and cosine of an angle in degrees. Angles on the 0.1 degree grid
+// (to float precision) come from a table built by quadrant symmetry, so 0,
+// 90, 180 and 270 degrees are exact; other angles fall back to sincos().
+void trig_sincos_deg(double deg, double *s, double *c);
+
+// unit bearing vector in the sensor frame (x forward, y left, z up, per
+// REP 103). Azimuth is measured counter-clockwise from x about z and
+// elevation up from the x-y plane, both in degrees.
+void bearing_to_vector(double elevation, double azimuth, double *x, double *y, double *z);
+
+#endif // TRIG_TABLE_H
@@ -0,0 +1,66 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <stdint.h>
+
+// what to do with deadlines that passed while the sender was late
+enum tx_overrun_policy
+{
+    TX_SKIP,        // drop them and keep to the grid: rate falls, timing holds
+    TX_CATCH_UP     // send them back to back: frame count holds, timing slips
+};
+
+// Paces a transmitter on absolute deadlines start + k / rate.
+//
+// A periodic CLOCK_MONOTONIC timerfd keeps the grid, so time spent sending
+// never accumulates into drift the way a sleep after each frame does, and
+// its expiration count tells how many deadlines passed while we were busy.
+// A rate of 0 or less sends as fast as the link takes frames.
+//
+//   sched.start(100, TX_SKIP);
+//   while (running)
+//       for (int n = sched.wait(); n > 0; n--)
+//       {
+//           send_frame();
+//           sched.sent();
+//       }
+class tx_scheduler
+{
+public:
+    tx_scheduler() {}
+    ~tx_scheduler();
+
+    // first deadline is one period from now; returns -1 if no timer
+    int start(double rate, tx_overrun_policy policy = TX_SKIP);
+    void stop();
+
+    // block until the next deadline; returns how many frames to send now,
+    // or -1 on error
+    int wait();
+    // record that the frame for the current deadline went out
+    void sent();
+
+    // lateness of the last frame against its deadline [s]
+    double last_jitter() const { return last_jitter_; }
+    double mean_jitter() const { return frames_ ? jitter_sum_ / frames_ : 0; }
+    double rms_jitter() const;
+    double max_jitter() const { return jitter_max_; }
+
+    uint64_t frames_ = 0;       // frames sent
+    uint64_t skipped_ = 0;      // deadlines dropped under TX_SKIP
+    uint64_t overruns_ = 0;     // wake ups that found more than one deadline due
+
+private:
+    int fd_ = -1;
+    tx_overrun_policy policy_ = TX_SKIP;
+    double period_ = 0;
+    double start_ = 0;
+    uint64_t deadline_ = 0;     // index k of the deadline being served
+
+    double last_jitter_ = 0;
+    double jitter_sum_ = 0;
+    double jitter_sum2_ = 0;
+    double jitter_max_ = 0;
+};
+
+#endif // TX_SCHEDULER_H
@@ -0,0 +1,86 @@
+#ifndef UDP_SINK_H
+#define UDP_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Bearings over UDP for consumers that are not on ROS.
+//
+// Every batch of frames decoded from one read becomes one datagram: a
+// udp_bearing_header followed by count udp_bearing records, all fields
+// little endian and packed. seq counts datagrams per sender, so a receiver
+// can see losses and reordering. Pending datagrams for every destination
+// (the multicast group plus any unicast receivers) go out in one sendmmsg.
+
+#define UDP_BEARING_MAGIC 0x42464452u     // "RDFB" read as little endian
+#define UDP_BEARING_VERSION 1
+#define UDP_BEARING_PORT 5600
+#define UDP_BEARING_GROUP "239.255.0.42"
+// records per datagram; 16 + 64 * 20 bytes stays below a 1500 byte MTU
+#define UDP_BEARING_MAX 64
+// datagrams held between two flush() calls
+#define UDP_SINK_QUEUE 8
+#define UDP_SINK_MAX_DEST 4
+
+struct __attribute__((packed)) udp_bearing_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t seq;
+    uint16_t device;
+    uint16_t reserved;
+};
+
+struct __attribute__((packed)) udp_bearing
+{
+    int64_t stamp;      // sample time [ns]
+    int32_t id;
+    float azimuth;      // [deg]
+    float elevation;    // [deg]
+};
+
+class udp_sink
+{
+public:
+    udp_sink() {}
+    ~udp_sink();
+
+    // send to host:port, a multicast group or a unicast address; may be
+    // called up to UDP_SINK_MAX_DEST times. ttl and interface (an address
+    // of the outgoing interface, or NULL) apply to multicast
+    int open(const char *host, int port, int ttl = 1, const char *interface = NULL);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    void set_device(uint16_t device) { device_ = device; }
+
+    // append one bearing to the current datagram
+    void add(int64_t stamp, int32_t id, float azimuth, float elevation);
+    // close the current datagram; the batch boundary of the node
+    void end_batch();
+    // send every closed datagram to every destination in one system call
+    int flush();
+
+    uint64_t sent_ = 0;
+    uint64_t errors_ = 0;
+
+private:
+    int fd_ = -1;
+    struct sockaddr_in dest_[UDP_SINK_MAX_DEST];
+    int ndest_ = 0;
+    uint16_t device_ = 0;
+    uint32_t seq_ = 0;
+
+    struct datagram
+    {
+        udp_bearing_header header;
+        udp_bearing records[UDP_BEARING_MAX];
+    } __attribute__((packed));
+    datagram queue_[UDP_SINK_QUEUE];
+    int queued_ = 0;        // closed datagrams
+    int count_ = 0;         // records in the open one
+};
+
+#endif // UDP_SINK_H
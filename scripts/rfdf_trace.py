@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+rfdf_trace.py
+
+Description:
+  Turns a trace written by the RFDF_TRACE tracepoints (rfdf_node
+  ~trace_file, rfdf_bench -t) into per-stage latencies
+
+Usage:
+  rfdf_trace.py TRACE [--csv FILE]
+
+  Stages, all in microseconds:
+    device    sample time to receive time of each frame, the
+              receiver, USB and kernel delay ahead of the read
+    read      time spent waiting in read()
+    parse     read() return to frame completion
+    publish   frame completion to the end of its publish batch
+    log       log writer enqueue to dequeue
+
+  --csv FILE writes one row per frame (id, read exit, frame,
+  publish end, device delay) as a timeline for plotting.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"RFDFTRC1"
+RECORD = struct.Struct("<QQIIqq")
+
+READ_ENTER, READ_EXIT, FRAME, PARSE_ERROR, ENQUEUE, DEQUEUE, \
+    PUBLISH_BEGIN, PUBLISH_END = range(1, 9)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC:
+        sys.exit("Error: %s is not an rfdf trace" % path)
+    count, = struct.unpack_from("<Q", data, 8)
+    return [RECORD.unpack_from(data, 16 + i * RECORD.size) for i in range(count)]
+
+
+def percentiles(values):
+    values = sorted(values)
+    n = len(values)
+    pick = lambda q: values[min(n - 1, int(q * n))]
+    return n, pick(0.5), pick(0.9), pick(0.99), values[-1]
+
+
+def analyze(records):
+    stages = {"device": [], "read": [], "parse": [], "publish": [], "log": []}
+    timeline = []
+    parse_errors = 0
+
+    # per thread state: last read() entry/exit, frames awaiting publish
+    entered = {}
+    exited = {}
+    pending = {}
+    enqueued = {}
+
+    for seq, t, event, tid, a, b in sorted(records, key=lambda r: r[1]):
+        if event == READ_ENTER:
+            entered[tid] = t
+        elif event == READ_EXIT:
+            if tid in entered:
+                stages["read"].append(t - entered.pop(tid))
+            exited[tid] = t
+        elif event == FRAME:
+            stages["device"].append(b)
+            if tid in exited:
+                stages["parse"].append(t - exited[tid])
+            pending.setdefault(tid, []).append((a, exited.get(tid), t, b))
+        elif event == PARSE_ERROR:
+            parse_errors += 1
+        elif event == PUBLISH_END:
+            for frame_id, read_exit, frame_t, device in pending.pop(tid, []):
+                stages["publish"].append(t - frame_t)
+                timeline.append((frame_id, read_exit, frame_t, t, device))
+        elif event == ENQUEUE:
+            enqueued[a] = t
+        elif event == DEQUEUE:
+            if a in enqueued:
+                stages["log"].append(t - enqueued.pop(a))
+
+    # frames of a run without publishing, such as rfdf_bench
+    for frames in pending.values():
+        for frame_id, read_exit, frame_t, device in frames:
+            timeline.append((frame_id, read_exit, frame_t, None, device))
+    return stages, sorted(timeline, key=lambda r: r[2]), parse_errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-stage latencies of an rfdf trace")
+    parser.add_argument("trace")
+    parser.add_argument("--csv", help="write a per-frame timeline to this file")
+    args = parser.parse_args()
+
+    records = load(args.trace)
+    stages, timeline, parse_errors = analyze(records)
+
+    print("%d records, %d frames, %d parse errors\n" % (len(records), len(timeline), parse_errors))
+    print("%-8s %9s %10s %10s %10s %10s" % ("stage", "count", "p50 us", "p90 us", "p99 us", "max us"))
+    for name in ("device", "read", "parse", "publish", "log"):
+        if not stages[name]:
+            continue
+        n, p50, p90, p99, top = percentiles(stages[name])
+        print("%-8s %9d %10.1f %10.1f %10.1f %10.1f" % (name, n, p50 / 1e3, p90 / 1e3, p99 / 1e3, top / 1e3))
+
+    if args.csv:
+        with open(args.csv, "w") as f:
+            f.write("id,read_exit_ns,frame_ns,publish_end_ns,device_ns\n")
+            for row in timeline:
+                f.write(",".join("" if v is None else str(v) for v in row) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+/**********************************************************
+bearing_fusion.cpp
+
+Description:
+  Incremental least squares triangulation of an
+  emitter from the bearings of several RFDF arrays
+
+*/
+
+#include "bearing_fusion.h"
+
+#include <math.h>
+#include <string.h>
+
+
+bearing_fusion::bearing_fusion(double forgetting, double bearing_sigma,
+                               double prior_sigma, double min_range)
+{
+    lambda_ = forgetting;
+    sigma2_ = bearing_sigma * bearing_sigma;
+    prior_var_ = prior_sigma * prior_sigma;
+    min_range_ = min_range;
+    memset(p_, 0, sizeof(p_));
+    memset(P_, 0, sizeof(P_));
+}
+
+void bearing_fusion::reset(const double prior[3])
+{
+    memcpy(p_, prior, sizeof(p_));
+    memset(P_, 0, sizeof(P_));
+    P_[0] = P_[4] = P_[8] = prior_var_;
+    bearings_ = 0;
+    have_prior_ = true;
+}
+
+void bearing_fusion::add(const double origin[3], const double dir[3])
+{
+    if (!have_prior_)
+        reset(origin);
+
+    // two unit normals of the bearing: cross with the axis least aligned
+    // with it, then complete the right-handed set
+    double ax[3] = {0, 0, 0};
+    double fx = fabs(dir[0]), fy = fabs(dir[1]), fz = fabs(dir[2]);
+    ax[fx <= fy && fx <= fz ? 0 : (fy <= fz ? 1 : 2)] = 1.0;
+
+    double n1[3] = {dir[1] * ax[2] - dir[2] * ax[1],
+                    dir[2] * ax[0] - dir[0] * ax[2],
+                    dir[0] * ax[1] - dir[1] * ax[0]};
+    double len = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+    if (len < 1e-9)
+        return;
+    n1[0] /= len; n1[1] /= len; n1[2] /= len;
+    double n2[3] = {dir[1] * n1[2] - dir[2] * n1[1],
+                    dir[2] * n1[0] - dir[0] * n1[2],
+                    dir[0] * n1[1] - dir[1] * n1[0]};
+
+    // cross-track error of a bearing grows with range
+    double d[3] = {p_[0] - origin[0], p_[1] - origin[1], p_[2] - origin[2]};
+    double range = d[0] * dir[0] + d[1] * dir[1] + d[2] * dir[2];
+    if (range < min_range_)
+        range = min_range_;
+    double r = sigma2_ * range * range;
+
+    for (int i = 0; i < 9; i++)
+        P_[i] /= lambda_;
+
+    update(n1, n1[0] * origin[0] + n1[1] * origin[1] + n1[2] * origin[2], r);
+    update(n2, n2[0] * origin[0] + n2[1] * origin[1] + n2[2] * origin[2], r);
+    bearings_++;
+}
+
+// scalar measurement y = n . p with variance r
+void bearing_fusion::update(const double n[3], double y, double r)
+{
+    double Pn[3];
+    for (int i = 0; i < 3; i++)
+        Pn[i] = P_[3 * i] * n[0] + P_[3 * i + 1] * n[1] + P_[3 * i + 2] * n[2];
+
+    double s = n[0] * Pn[0] + n[1] * Pn[1] + n[2] * Pn[2] + r;
+    double innovation = y - (n[0] * p_[0] + n[1] * p_[1] + n[2] * p_[2]);
+
+    for (int i = 0; i < 3; i++)
+        p_[i] += Pn[i] / s * innovation;
+    for (int i = 0; i < 3; i++)
+        for (int j = i; j < 3; j++)
+        {
+            double v = P_[3 * i + j] - Pn[i] * Pn[j] / s;
+            P_[3 * i + j] = v;
+            P_[3 * j + i] = v;
+        }
+}
@@ -0,0 +1,165 @@
+/**********************************************************
+bearing_grid.cpp
+
+Description:
+  Accumulates bearings into a decaying emitter
+  likelihood grid for search missions
+
+*/
+
+#include "bearing_grid.h"
+
+#include <math.h>
+#include <string.h>
+
+// wedges are cut off at this many sigma off the bearing
+#define BEARING_GRID_WEDGE_SIGMAS 3.0
+// fold the lazy decay back into the cells once new evidence is scaled
+// up by this much, well before float precision suffers
+#define BEARING_GRID_MAX_GAIN 1e3
+
+
+bearing_grid::bearing_grid(int width, int height, double resolution, double origin_x, double origin_y,
+                           double half_life, double wedge_sigma, double max_range)
+{
+    width_ = width < 1 ? 1 : width;
+    height_ = height < 1 ? 1 : height;
+    stride_ = (width_ + 3) / 4;
+    resolution_ = resolution;
+    origin_x_ = origin_x;
+    origin_y_ = origin_y;
+    tau_ = half_life / M_LN2;
+    double t = tan(wedge_sigma);
+    wedge_k_ = 1.0 / (t * t);
+    half_angle_ = BEARING_GRID_WEDGE_SIGMAS * wedge_sigma;
+    max_range_ = max_range;
+
+    cells_.resize((size_t)stride_ * height_);
+    clear();
+}
+
+void bearing_grid::clear()
+{
+    memset(cells_.data(), 0, cells_.size() * sizeof(v4sf));
+    have_t_ref_ = false;
+}
+
+void bearing_grid::renormalize(double t)
+{
+    v4sf scale = {0, 0, 0, 0};
+    scale += (float)exp(-(t - t_ref_) / tau_);
+    for (size_t i = 0; i < cells_.size(); i++)
+        cells_[i] *= scale;
+    t_ref_ = t;
+}
+
+void bearing_grid::add(double x, double y, double dx, double dy, double t, double weight)
+{
+    if (!have_t_ref_)
+    {
+        t_ref_ = t;
+        have_t_ref_ = true;
+    }
+    double gain = exp((t - t_ref_) / tau_);
+    if (gain > BEARING_GRID_MAX_GAIN)
+    {
+        renormalize(t);
+        gain = 1.0;
+    }
+
+    // bounding box of the wedge: the array, the far ends of its edges and
+    // axis, padded by how far the arc bulges past them; for wide wedges,
+    // the whole disc
+    double xmin = x, xmax = x, ymin = y, ymax = y;
+    if (half_angle_ >= M_PI / 2)
+    {
+        xmin = x - max_range_; xmax = x + max_range_;
+        ymin = y - max_range_; ymax = y + max_range_;
+    }
+    else
+    {
+        double heading = atan2(dy, dx);
+        double angles[3] = {heading - half_angle_, heading, heading + half_angle_};
+        for (int i = 0; i < 3; i++)
+        {
+            double ex = x + max_range_ * cos(angles[i]);
+            double ey = y + max_range_ * sin(angles[i]);
+            xmin = fmin(xmin, ex); xmax = fmax(xmax, ex);
+            ymin = fmin(ymin, ey); ymax = fmax(ymax, ey);
+        }
+        double bulge = max_range_ * (1 - cos(half_angle_));
+        xmin -= bulge; xmax += bulge;
+        ymin -= bulge; ymax += bulge;
+    }
+
+    int c0 = (int)floor((xmin - origin_x_) / resolution_);
+    int c1 = (int)floor((xmax - origin_x_) / resolution_);
+    int r0 = (int)floor((ymin - origin_y_) / resolution_);
+    int r1 = (int)floor((ymax - origin_y_) / resolution_);
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= width_) c1 = width_ - 1;
+    if (r1 >= height_) r1 = height_ - 1;
+    if (c0 > c1 || r0 > r1)
+        return;
+
+    // work in whole vectors; the padding columns past width_ are never read
+    int v0 = c0 / 4;
+    int v1 = c1 / 4;
+
+    const float res = (float)resolution_;
+    const v4sf lane = {0.5f * res, 1.5f * res, 2.5f * res, 3.5f * res};
+    const v4sf zero = {0, 0, 0, 0};
+    const v4sf fdx = zero + (float)dx;
+    const v4sf fdy = zero + (float)dy;
+    const v4sf k = zero + (float)wedge_k_;
+    const v4sf range2 = zero + (float)(max_range_ * max_range_);
+    const v4sf w = zero + (float)(weight * gain);
+    const v4sf cos_cut = zero + (float)cos(half_angle_);
+    const v4sf tiny = zero + 1e-12f;
+    // cell centres relative to the array, in float for the kernel
+    const float x_rel = (float)(origin_x_ - x);
+    const float y_rel = (float)(origin_y_ - y);
+
+    for (int r = r0; r <= r1; r++)
+    {
+        v4sf *row = &cells_[(size_t)r * stride_];
+        const v4sf vy = zero + (y_rel + (r + 0.5f) * res);
+        const v4sf vy_dx = vy * fdx;
+        const v4sf vy_dy = vy * fdy;
+        const v4sf vy2 = vy * vy;
+
+        for (int v = v0; v <= v1; v++)
+        {
+            v4sf vx = lane + (x_rel + 4.0f * v * res);
+            v4sf along = vx * fdx + vy_dy;
+            v4sf cross = vy_dx - vx * fdy;
+            v4sf dist2 = vx * vx + vy2;
+            v4sf along2 = along * along;
+            v4sf lik = w * along2 / (along2 + k * cross * cross + tiny);
+            // in front of the array, inside the cut-off angle and range
+            v4sf keep = (along > zero && along2 >= cos_cut * cos_cut * dist2 && dist2 <= range2)
+                        ? lik : zero;
+            row[v] += keep;
+        }
+    }
+}
+
+float bearing_grid::snapshot(double t, int8_t *out) const
+{
+    const float *cells = (const float *)cells_.data();
+    float max = 0;
+
+    for (int r = 0; r < height_; r++)
+        for (int c = 0; c < width_; c++)
+            max = fmaxf(max, cells[(size_t)r * stride_ * 4 + c]);
+
+    float scale = max > 0 ? 100.0f / max : 0.0f;
+    for (int r = 0; r < height_; r++)
+        for (int c = 0; c < width_; c++)
+            out[(size_t)r * width_ + c] = (int8_t)lrintf(cells[(size_t)r * stride_ * 4 + c] * scale);
+
+    if (!have_t_ref_)
+        return 0;
+    return max * (float)exp(-(t - t_ref_) / tau_);
+}
@@ -0,0 +1,515 @@
+/**********************************************************
+bearing_log.cpp
+
+Description:
+  Columnar on-disk log of parsed bearings, written in
+  the background and read back through mmap
+
+*/
+
+#include "bearing_log.h"
+#include "rfdf_trace.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define DEG2RAD (M_PI / 180.0)
+
+// how long the writer thread sleeps when the queue is empty
+#define BEARING_LOG_IDLE_MS 20
+
+struct bearing_log_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct bearing_log_trailer
+{
+    uint64_t index_offset;
+    uint64_t blocks;
+    char magic[8];
+};
+
+// bytes of one record across all columns
+#define BEARING_LOG_RECORD_BYTES (8 + 8 + 4 + 4 + 4 + 2)
+
+
+// --------------------------------------------------------
+// Summary: sums that merge across blocks
+
+void bearing_summary::clear()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+void bearing_summary::add(const bearing_record &r)
+{
+    if (count == 0 || r.stamp < t_min) t_min = r.stamp;
+    if (count == 0 || r.stamp > t_max) t_max = r.stamp;
+    if (count == 0 || r.id < id_min) id_min = r.id;
+    if (count == 0 || r.id > id_max) id_max = r.id;
+    count++;
+    sum_sin_az += sin(r.azimuth * DEG2RAD);
+    sum_cos_az += cos(r.azimuth * DEG2RAD);
+    sum_el += r.elevation;
+    sum_el2 += (double)r.elevation * r.elevation;
+    double latency = 1e-9 * (r.recv_stamp - r.stamp);
+    sum_latency += latency;
+    sum_latency2 += latency * latency;
+}
+
+void bearing_summary::merge(const bearing_summary &o)
+{
+    if (o.count == 0)
+        return;
+    if (count == 0)
+    {
+        *this = o;
+        return;
+    }
+    if (o.t_min < t_min) t_min = o.t_min;
+    if (o.t_max > t_max) t_max = o.t_max;
+    if (o.id_min < id_min) id_min = o.id_min;
+    if (o.id_max > id_max) id_max = o.id_max;
+    count += o.count;
+    sum_sin_az += o.sum_sin_az;
+    sum_cos_az += o.sum_cos_az;
+    sum_el += o.sum_el;
+    sum_el2 += o.sum_el2;
+    sum_latency += o.sum_latency;
+    sum_latency2 += o.sum_latency2;
+}
+
+
+// --------------------------------------------------------
+// Writer
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+bearing_log_writer::bearing_log_writer()
+    : written_(0), dropped_(0), stop_(false), head_(0), tail_(0)
+{
+    queue_ = new bearing_record[BEARING_LOG_QUEUE];
+    block_ = new bearing_record[BEARING_LOG_BLOCK];
+    raw_.resize(BEARING_LOG_BLOCK * BEARING_LOG_RECORD_BYTES);
+    comp_.resize(compressBound(raw_.size()));
+}
+
+bearing_log_writer::~bearing_log_writer()
+{
+    close();
+    delete[] queue_;
+    delete[] block_;
+}
+
+int bearing_log_writer::open(const char *path)
+{
+    close();
+    fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        return -1;
+
+    bearing_log_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BEARING_LOG_MAGIC, 8);
+    header.version = BEARING_LOG_VERSION;
+    if (write_all(fd_, &header, sizeof(header)) < 0)
+    {
+        int err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        errno = err;
+        return -1;
+    }
+    offset_ = sizeof(header);
+    failed_ = false;
+    block_len_ = 0;
+    index_.clear();
+    head_ = tail_ = 0;
+    stop_ = false;
+    thread_ = std::thread(&bearing_log_writer::run, this);
+    return 0;
+}
+
+void bearing_log_writer::log(const bearing_record &r)
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= BEARING_LOG_QUEUE)
+    {
+        dropped_++;
+        return;
+    }
+    queue_[head & (BEARING_LOG_QUEUE - 1)] = r;
+    head_.store(head + 1, std::memory_order_release);
+    RFDF_TRACE(TRACE_ENQUEUE, r.id, 0);
+}
+
+void bearing_log_writer::close()
+{
+    if (fd_ < 0)
+        return;
+    stop_ = true;
+    if (thread_.joinable())
+        thread_.join();
+
+    // sparse index and trailer
+    bearing_log_trailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = offset_;
+    trailer.blocks = index_.size();
+    memcpy(trailer.magic, BEARING_LOG_INDEX_MAGIC, 8);
+    if (!failed_)
+    {
+        write_all(fd_, index_.data(), index_.size() * sizeof(bearing_index_entry));
+        write_all(fd_, &trailer, sizeof(trailer));
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void bearing_log_writer::run()
+{
+    while (true)
+    {
+        bool stopping = stop_.load();
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+
+        for (; tail != head; tail++)
+        {
+            block_[block_len_++] = queue_[tail & (BEARING_LOG_QUEUE - 1)];
+            RFDF_TRACE(TRACE_DEQUEUE, block_[block_len_ - 1].id, 0);
+            if (block_len_ == BEARING_LOG_BLOCK)
+            {
+                tail_.store(tail + 1, std::memory_order_release);
+                flush_block();
+            }
+        }
+        tail_.store(tail, std::memory_order_release);
+
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(BEARING_LOG_IDLE_MS));
+    }
+    flush_block();
+}
+
+// lay the block out column by column, compress and append it
+void bearing_log_writer::flush_block()
+{
+    if (block_len_ == 0)
+        return;
+    if (failed_)
+    {
+        dropped_ += block_len_;
+        block_len_ = 0;
+        return;
+    }
+
+    bearing_block_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "BLK1", 4);
+    header.count = block_len_;
+    header.summary.clear();
+
+    unsigned char *p = raw_.data();
+    int64_t prev = 0;
+    for (uint32_t i = 0; i < block_len_; i++)
+    {
+        int64_t delta = block_[i].stamp - prev;
+        prev = block_[i].stamp;
+        memcpy(p, &delta, 8);
+        p += 8;
+        header.summary.add(block_[i]);
+    }
+    for (uint32_t i = 0; i < block_len_; i++, p += 8)
+    {
+        int64_t latency = block_[i].recv_stamp - block_[i].stamp;
+        memcpy(p, &latency, 8);
+    }
+    for (uint32_t i = 0; i < block_len_; i++, p += 4)
+        memcpy(p, &block_[i].id, 4);
+    for (uint32_t i = 0; i < block_len_; i++, p += 4)
+        memcpy(p, &block_[i].azimuth, 4);
+    for (uint32_t i = 0; i < block_len_; i++, p += 4)
+        memcpy(p, &block_[i].elevation, 4);
+    for (uint32_t i = 0; i < block_len_; i++, p += 2)
+        memcpy(p, &block_[i].device, 2);
+
+    header.raw_size = p - raw_.data();
+    uLongf comp_size = comp_.size();
+    if (compress2(comp_.data(), &comp_size, raw_.data(), header.raw_size, Z_BEST_SPEED) != Z_OK)
+    {
+        dropped_ += block_len_;
+        block_len_ = 0;
+        return;
+    }
+    header.comp_size = comp_size;
+
+    bearing_index_entry entry;
+    entry.offset = offset_;
+    entry.summary = header.summary;
+
+    if (write_all(fd_, &header, sizeof(header)) < 0 ||
+        write_all(fd_, comp_.data(), comp_size) < 0)
+    {
+        // cut off whatever part of the block made it, so the next block
+        // lands where its index entry says
+        int err = errno;
+        if (ftruncate(fd_, offset_) < 0 || lseek(fd_, offset_, SEEK_SET) < 0)
+        {
+            failed_ = true;
+            printf("Error: Bearing log stopped, a failed block could not be removed - %s\n",
+                   strerror(errno));
+        }
+        else
+        {
+            printf("Warning: Dropped a bearing log block - %s\n", strerror(err));
+        }
+        dropped_ += block_len_;
+        block_len_ = 0;
+        return;
+    }
+    offset_ += sizeof(header) + comp_size;
+    index_.push_back(entry);
+    written_ += block_len_;
+    block_len_ = 0;
+}
+
+
+// --------------------------------------------------------
+// Reader
+
+bearing_log_reader::~bearing_log_reader()
+{
+    close();
+}
+
+int bearing_log_reader::open(const char *path)
+{
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(bearing_log_file_header))
+    {
+        ::close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    size_ = st.st_size;
+    void *map = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    map_ = (const unsigned char *)map;
+    data_end_ = size_;
+
+    // the structures in the file sit at any offset, so they are copied out
+    // rather than read in place
+    bearing_log_file_header header;
+    memcpy(&header, map_, sizeof(header));
+    if (memcmp(header.magic, BEARING_LOG_MAGIC, 8) != 0 || header.version != BEARING_LOG_VERSION)
+    {
+        close();
+        errno = EINVAL;
+        return -1;
+    }
+
+    // use the index written on close if it is there and consistent
+    if (size_ >= sizeof(bearing_log_file_header) + sizeof(bearing_log_trailer))
+    {
+        bearing_log_trailer trailer;
+        memcpy(&trailer, map_ + size_ - sizeof(trailer), sizeof(trailer));
+        uint64_t index_end = size_ - sizeof(trailer);
+        if (memcmp(trailer.magic, BEARING_LOG_INDEX_MAGIC, 8) == 0 &&
+            trailer.index_offset >= sizeof(bearing_log_file_header) && trailer.index_offset <= index_end &&
+            trailer.blocks == (index_end - trailer.index_offset) / sizeof(bearing_index_entry) &&
+            trailer.index_offset + trailer.blocks * sizeof(bearing_index_entry) == index_end)
+        {
+            index_.resize(trailer.blocks);
+            memcpy(index_.data(), map_ + trailer.index_offset, trailer.blocks * sizeof(bearing_index_entry));
+            data_end_ = trailer.index_offset;
+            indexed_ = true;
+            bearing_block_header block;
+            for (size_t i = 0; i < index_.size() && indexed_; i++)
+                indexed_ = block_header(index_[i].offset, block);
+            if (indexed_)
+            {
+                check_order();
+                return 0;
+            }
+            // an index pointing outside the blocks: trust the headers instead
+            index_.clear();
+            data_end_ = size_;
+        }
+    }
+    scan_blocks();
+    check_order();
+    return 0;
+}
+
+// header of the block at offset, if the whole block lies inside the data
+bool bearing_log_reader::block_header(uint64_t offset, bearing_block_header &header) const
+{
+    if (offset < sizeof(bearing_log_file_header) || offset > data_end_ ||
+        data_end_ - offset < sizeof(bearing_block_header))
+        return false;
+    memcpy(&header, map_ + offset, sizeof(header));
+    return memcmp(header.magic, "BLK1", 4) == 0 &&
+           header.comp_size <= data_end_ - offset - sizeof(bearing_block_header);
+}
+
+// blocks of a log written across a clock step may overlap or run
+// backwards; the binary search and the early exit rely on neither
+void bearing_log_reader::check_order()
+{
+    monotonic_ = true;
+    for (size_t i = 1; i < index_.size(); i++)
+        if (index_[i].summary.t_min < index_[i - 1].summary.t_min ||
+            index_[i].summary.t_max < index_[i - 1].summary.t_max)
+            monotonic_ = false;
+}
+
+void bearing_log_reader::close()
+{
+    if (map_)
+        munmap((void *)map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+    data_end_ = 0;
+    indexed_ = false;
+    monotonic_ = true;
+    index_.clear();
+}
+
+// rebuild the index of an unclosed log from the block headers
+int bearing_log_reader::scan_blocks()
+{
+    uint64_t offset = sizeof(bearing_log_file_header);
+    bearing_block_header header;
+    while (block_header(offset, header))
+    {
+        bearing_index_entry entry;
+        entry.offset = offset;
+        entry.summary = header.summary;
+        index_.push_back(entry);
+        offset += sizeof(bearing_block_header) + header.comp_size;
+    }
+    return 0;
+}
+
+int bearing_log_reader::read_block(size_t i, std::vector<bearing_record> &out) const
+{
+    bearing_block_header header;
+    if (i >= index_.size() || !block_header(index_[i].offset, header))
+        return -1;
+    uint32_t n = header.count;
+    if (n > BEARING_LOG_BLOCK || header.raw_size != n * BEARING_LOG_RECORD_BYTES)
+        return -1;
+
+    std::vector<unsigned char> raw(header.raw_size);
+    uLongf raw_size = raw.size();
+    const Bytef *comp = map_ + index_[i].offset + sizeof(bearing_block_header);
+    if (uncompress(raw.data(), &raw_size, comp, header.comp_size) != Z_OK || raw_size != raw.size())
+        return -1;
+
+    out.resize(n);
+    const unsigned char *p = raw.data();
+    int64_t stamp = 0;
+    for (uint32_t j = 0; j < n; j++, p += 8)
+    {
+        int64_t delta;
+        memcpy(&delta, p, 8);
+        stamp += delta;
+        out[j].stamp = stamp;
+    }
+    for (uint32_t j = 0; j < n; j++, p += 8)
+    {
+        int64_t latency;
+        memcpy(&latency, p, 8);
+        out[j].recv_stamp = out[j].stamp + latency;
+    }
+    for (uint32_t j = 0; j < n; j++, p += 4)
+        memcpy(&out[j].id, p, 4);
+    for (uint32_t j = 0; j < n; j++, p += 4)
+        memcpy(&out[j].azimuth, p, 4);
+    for (uint32_t j = 0; j < n; j++, p += 4)
+        memcpy(&out[j].elevation, p, 4);
+    for (uint32_t j = 0; j < n; j++, p += 2)
+        memcpy(&out[j].device, p, 2);
+    return n;
+}
+
+size_t bearing_log_reader::lower_bound(int64_t t) const
+{
+    if (!monotonic_)
+        return 0;
+    size_t lo = 0, hi = index_.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (index_[mid].summary.t_max < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bearing_summary bearing_log_reader::stats(int64_t t0, int64_t t1) const
+{
+    bearing_summary total;
+    total.clear();
+    std::vector<bearing_record> records;
+
+    for (size_t i = lower_bound(t0); i < index_.size(); i++)
+    {
+        const bearing_summary &s = index_[i].summary;
+        if (!overlaps(i, t0, t1))
+        {
+            if (monotonic_ && s.t_min > t1)
+                break;
+            continue;
+        }
+        if (s.t_min >= t0 && s.t_max <= t1)
+        {
+            total.merge(s);
+            continue;
+        }
+        if (read_block(i, records) < 0)
+            break;
+        for (size_t j = 0; j < records.size(); j++)
+            if (records[j].stamp >= t0 && records[j].stamp <= t1)
+                total.add(records[j]);
+    }
+    return total;
+}
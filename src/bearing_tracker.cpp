@@ -0,0 +1,259 @@
+/**********************************************************
+bearing_tracker.cpp
+
+Description:
+  Constant rate Kalman tracker of azimuth and elevation,
+  and its shared memory publication for other processes
+
+*/
+
+#include "bearing_tracker.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define TRACKER_SHM_MAGIC 0x4b525452u   // "RTRK" read as little endian
+// rate uncertainty of a new track, 90 deg/s one sigma
+#define TRACKER_RATE_VAR (90.0 * 90.0)
+// reads of an odd sequence number before giving up; a publish takes well
+// under a microsecond, so only a node that died mid publish gets here
+#define TRACKER_READ_RETRIES 100000
+
+
+static double wrap180(double a)
+{
+    a = fmod(a + 180.0, 360.0);
+    if (a < 0)
+        a += 360.0;
+    return a - 180.0;
+}
+
+static void axis_predict(const tracker_axis &x, double q, double dt, tracker_axis &y)
+{
+    double dt2 = dt * dt;
+    y.angle = x.angle + x.rate * dt;
+    y.rate = x.rate;
+    y.p_aa = x.p_aa + 2 * dt * x.p_ar + dt2 * x.p_rr + q * dt2 * dt / 3;
+    y.p_ar = x.p_ar + dt * x.p_rr + q * dt2 / 2;
+    y.p_rr = x.p_rr + q * dt;
+}
+
+static void axis_update(tracker_axis &x, double innovation, double r)
+{
+    double s = x.p_aa + r;
+    double k_a = x.p_aa / s, k_r = x.p_ar / s;
+    x.angle += k_a * innovation;
+    x.rate += k_r * innovation;
+    double p_aa = x.p_aa, p_ar = x.p_ar;
+    x.p_aa = (1 - k_a) * p_aa;
+    x.p_ar = (1 - k_a) * p_ar;
+    x.p_rr -= k_r * p_ar;
+}
+
+static void axis_start(tracker_axis &x, double angle, double r)
+{
+    x.angle = angle;
+    x.rate = 0;
+    x.p_aa = r;
+    x.p_ar = 0;
+    x.p_rr = TRACKER_RATE_VAR;
+}
+
+bool tracker_predict(const tracker_state &s, double t, bearing_prediction &p)
+{
+    if (s.updates == 0)
+        return false;
+
+    double dt = t - s.stamp;
+    tracker_axis az, el;
+    axis_predict(s.azimuth, s.accel_noise, dt, az);
+    axis_predict(s.elevation, s.accel_noise, dt, el);
+
+    p.azimuth = wrap180(az.angle - 180.0) + 180.0;
+    p.elevation = el.angle;
+    p.azimuth_rate = az.rate;
+    p.elevation_rate = el.rate;
+    p.azimuth_cov[0] = az.p_aa;
+    p.azimuth_cov[1] = p.azimuth_cov[2] = az.p_ar;
+    p.azimuth_cov[3] = az.p_rr;
+    p.elevation_cov[0] = el.p_aa;
+    p.elevation_cov[1] = p.elevation_cov[2] = el.p_ar;
+    p.elevation_cov[3] = el.p_rr;
+    p.age = dt;
+    return true;
+}
+
+
+// --------------------------------------------------------
+// Tracker
+
+bearing_tracker::bearing_tracker(double accel_noise, double bearing_sigma, double timeout)
+{
+    memset(&state_, 0, sizeof(state_));
+    state_.accel_noise = accel_noise > 0 ? accel_noise : 0;
+    r_ = bearing_sigma * bearing_sigma;
+    if (r_ <= 0)
+        r_ = 1e-6;
+    timeout_ = timeout;
+}
+
+void bearing_tracker::reset()
+{
+    state_.updates = 0;
+}
+
+void bearing_tracker::start(double stamp, float azimuth, float elevation)
+{
+    if (state_.updates > 0)
+        state_.resets++;
+    axis_start(state_.azimuth, azimuth, r_);
+    axis_start(state_.elevation, elevation, r_);
+    state_.stamp = stamp;
+    state_.updates = 1;
+}
+
+void bearing_tracker::update(double stamp, float azimuth, float elevation)
+{
+    // a jump back further than the timeout is the clock restarting (a bag
+    // looping, sim time reset), not a late frame: restart the track too
+    double dt = stamp - state_.stamp;
+    if (state_.updates == 0 || fabs(dt) > timeout_)
+    {
+        start(stamp, azimuth, elevation);
+        return;
+    }
+    if (dt < 0)
+    {
+        out_of_order_++;
+        return;
+    }
+
+    axis_predict(state_.azimuth, state_.accel_noise, dt, state_.azimuth);
+    axis_predict(state_.elevation, state_.accel_noise, dt, state_.elevation);
+    axis_update(state_.azimuth, wrap180(azimuth - state_.azimuth.angle), r_);
+    axis_update(state_.elevation, elevation - state_.elevation.angle, r_);
+
+    // keep the unwrapped azimuth near the measurements so it never loses
+    // precision, without touching the rate
+    if (fabs(state_.azimuth.angle) > 720.0)
+        state_.azimuth.angle = wrap180(state_.azimuth.angle);
+    state_.stamp = stamp;
+    state_.updates++;
+}
+
+
+// --------------------------------------------------------
+// Shared memory
+
+// seq is odd while the node is writing
+struct tracker_shm::block
+{
+    uint32_t seq;
+    uint32_t magic;
+    tracker_state state;
+};
+
+tracker_shm::~tracker_shm()
+{
+    close();
+}
+
+int tracker_shm::map(int device, int flags)
+{
+    close();
+    void *m;
+    if (device < 0)
+    {
+        m = mmap(NULL, sizeof(block), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    else
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/rfdf_track_%d", device);
+        int fd = shm_open(name, flags, 0666);
+        if (fd < 0)
+            return -1;
+        if ((flags & O_CREAT) && ftruncate(fd, sizeof(block)) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        m = mmap(NULL, sizeof(block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+    }
+    if (m == MAP_FAILED)
+        return -1;
+    shm_ = (block *)m;
+    return 0;
+}
+
+int tracker_shm::create(int device)
+{
+    if (map(device, O_RDWR | O_CREAT) < 0)
+        return -1;
+    // a restarted node starts over with no state
+    __atomic_store_n(&shm_->seq, 0, __ATOMIC_RELEASE);
+    shm_->magic = TRACKER_SHM_MAGIC;
+    return 0;
+}
+
+int tracker_shm::open(int device)
+{
+    if (map(device, O_RDWR) < 0)
+        return -1;
+    if (shm_->magic != TRACKER_SHM_MAGIC)
+    {
+        close();
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+void tracker_shm::close()
+{
+    if (shm_)
+        munmap(shm_, sizeof(block));
+    shm_ = nullptr;
+}
+
+void tracker_shm::publish(const tracker_state &s)
+{
+    if (!shm_)
+        return;
+    uint32_t seq = __atomic_load_n(&shm_->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm_->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shm_->state = s;
+    __atomic_store_n(&shm_->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+bool tracker_shm::read(tracker_state &s) const
+{
+    if (!shm_)
+        return false;
+    for (int retries = 0; retries < TRACKER_READ_RETRIES; retries++)
+    {
+        uint32_t seq = __atomic_load_n(&shm_->seq, __ATOMIC_ACQUIRE);
+        if (seq == 0)
+            return false;
+        if (seq & 1)
+            continue;
+        s = shm_->state;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm_->seq, __ATOMIC_RELAXED) == seq)
+            return true;
+    }
+    return false;
+}
+
+bool tracker_shm::predict(double t, bearing_prediction &p) const
+{
+    tracker_state s;
+    return read(s) && tracker_predict(s, t, p);
+}
@@ -0,0 +1,115 @@
+/**********************************************************
+circular_filter.cpp
+
+Description:
+  O(1) sliding-window circular statistics used to
+  smooth azimuth and elevation bearings
+
+*/
+
+#include "circular_filter.h"
+#include "trig_table.h"
+
+#include <math.h>
+
+#define RAD2DEG (180.0 / M_PI)
+
+// recompute the running sums from the window this often to stop the
+// add/subtract round-off from accumulating
+#define CIRCULAR_FILTER_RESUM 4096
+
+
+circular_filter::circular_filter(int window, double gate)
+{
+    configure(window, gate);
+}
+
+void circular_filter::configure(int window, double gate)
+{
+    if (window < 1)
+        window = 1;
+    if (window > CIRCULAR_FILTER_MAX_WINDOW)
+        window = CIRCULAR_FILTER_MAX_WINDOW;
+    window_ = window;
+    gate_ = gate;
+    reset();
+}
+
+void circular_filter::reset()
+{
+    head_ = 0;
+    count_ = 0;
+    sum_sin_ = 0;
+    sum_cos_ = 0;
+    since_resum_ = 0;
+    consecutive_gated_ = 0;
+}
+
+bool circular_filter::update(double deg)
+{
+    double s, c;
+    trig_sincos_deg(deg, &s, &c);
+
+    // gate once the window holds enough samples to trust the mean; a run of
+    // a full window of rejects means the bearing really moved, so restart
+    if (gate_ > 0 && count_ * 2 >= window_)
+    {
+        double d = fabs(remainder(deg - mean(), 360.0));
+        if (d > gate_)
+        {
+            gated_++;
+            if (++consecutive_gated_ < window_)
+                return false;
+            reset();
+        }
+    }
+    consecutive_gated_ = 0;
+
+    if (count_ == window_)
+    {
+        sum_sin_ -= sin_[head_];
+        sum_cos_ -= cos_[head_];
+    }
+    else
+    {
+        count_++;
+    }
+    sin_[head_] = s;
+    cos_[head_] = c;
+    sum_sin_ += s;
+    sum_cos_ += c;
+    if (++head_ == window_)
+        head_ = 0;
+
+    if (++since_resum_ >= CIRCULAR_FILTER_RESUM)
+        resum();
+    return true;
+}
+
+double circular_filter::mean() const
+{
+    double m = atan2(sum_sin_, sum_cos_) * RAD2DEG;
+    if (m < 0)
+        m += 360.0;
+    return m >= 360.0 ? 0.0 : m;
+}
+
+double circular_filter::variance() const
+{
+    if (count_ == 0)
+        return 1.0;
+    double r = sqrt(sum_sin_ * sum_sin_ + sum_cos_ * sum_cos_) / count_;
+    return r > 1.0 ? 0.0 : 1.0 - r;
+}
+
+void circular_filter::resum()
+{
+    sum_sin_ = 0;
+    sum_cos_ = 0;
+    for (int i = 0; i < count_; i++)
+    {
+        sum_sin_ += sin_[i];
+        sum_cos_ += cos_[i];
+    }
+    since_resum_ = 0;
+}
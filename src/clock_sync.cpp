@@ -0,0 +1,148 @@
+/**********************************************************
+clock_sync.cpp
+
+Description:
+  Recovers the sample time of Gizmo frames from their
+  frame id and host receive time
+
+*/
+
+#include "clock_sync.h"
+
+#include <math.h>
+
+// smallest residual sigma used for gating (100 us)
+#define CLOCK_SYNC_MIN_SIGMA 1e-4
+// move the regression origin once ids drift this far from it
+#define CLOCK_SYNC_RECENTER (1 << 20)
+
+
+clock_sync::clock_sync(double half_life, double gate, int warmup)
+{
+    if (half_life < 1.0)
+        half_life = 1.0;
+    lambda_ = pow(0.5, 1.0 / half_life);
+    gate_ = gate;
+    warmup_ = warmup < 2 ? 2 : warmup;
+}
+
+void clock_sync::reset()
+{
+    have_origin_ = false;
+    sw_ = sx_ = sy_ = sxx_ = sxy_ = 0;
+    slope_ = intercept_ = 0;
+    resid_var_ = 0;
+    floor_ = 0;
+    consecutive_rejects_ = 0;
+    accepted_ = 0;
+}
+
+double clock_sync::residual_sigma() const
+{
+    return sqrt(resid_var_);
+}
+
+double clock_sync::sample_time(int64_t id) const
+{
+    if (!locked())
+        return -1;
+    double x = (double)(id - id0_);
+    return t0_ + intercept_ + slope_ * x + floor_;
+}
+
+double clock_sync::update(int64_t id, double recv_time)
+{
+    if (have_origin_ && id <= last_id_)
+    {
+        // counter restarted or wrapped: the old fit no longer applies
+        if (id == last_id_)
+            return locked() ? sample_time(id) : recv_time;
+        reset();
+        resets_++;
+    }
+
+    if (!have_origin_)
+    {
+        have_origin_ = true;
+        id0_ = id;
+        t0_ = recv_time;
+    }
+    last_id_ = id;
+
+    if (id - id0_ > CLOCK_SYNC_RECENTER)
+        recenter(id);
+
+    double x = (double)(id - id0_);
+    double y = recv_time - t0_;
+    double r = y - (intercept_ + slope_ * x);
+
+    if (locked())
+    {
+        double sigma = sqrt(resid_var_);
+        if (sigma < CLOCK_SYNC_MIN_SIGMA)
+            sigma = CLOCK_SYNC_MIN_SIGMA;
+        if (fabs(r) > gate_ * sigma)
+        {
+            rejected_++;
+            // a long run of rejects means the device clock stepped
+            if (++consecutive_rejects_ > (int)warmup_)
+            {
+                reset();
+                resets_++;
+                return update(id, recv_time);
+            }
+            double est = sample_time(id);
+            return est < recv_time ? est : recv_time;
+        }
+    }
+    consecutive_rejects_ = 0;
+
+    sw_ = lambda_ * sw_ + 1.0;
+    sx_ = lambda_ * sx_ + x;
+    sy_ = lambda_ * sy_ + y;
+    sxx_ = lambda_ * sxx_ + x * x;
+    sxy_ = lambda_ * sxy_ + x * y;
+    if (accepted_ > 1)
+        resid_var_ += (1.0 - lambda_) * (r * r - resid_var_);
+    accepted_++;
+    solve();
+
+    if (!locked())
+        return recv_time;
+
+    // follow the fastest frames down immediately and drift back up slowly
+    double r_fit = y - (intercept_ + slope_ * x);
+    if (r_fit < floor_)
+        floor_ = r_fit;
+    else
+        floor_ += (1.0 - lambda_) * (r_fit - floor_);
+
+    double est = sample_time(id);
+    return est < recv_time ? est : recv_time;
+}
+
+void clock_sync::solve()
+{
+    double den = sw_ * sxx_ - sx_ * sx_;
+    if (den <= 1e-12 * sw_ * sxx_ || sw_ <= 0)
+        return;
+    slope_ = (sw_ * sxy_ - sx_ * sy_) / den;
+    intercept_ = (sy_ - slope_ * sx_) / sw_;
+}
+
+// shift the origin to the current id so x stays small and the sums keep
+// their precision on long runs
+void clock_sync::recenter(int64_t id)
+{
+    double dx = (double)(id - id0_);
+    double dy = intercept_ + slope_ * dx;
+
+    sxy_ = sxy_ - dx * sy_ - dy * sx_ + sw_ * dx * dy;
+    sxx_ = sxx_ - 2.0 * dx * sx_ + sw_ * dx * dx;
+    sx_ -= sw_ * dx;
+    sy_ -= sw_ * dy;
+
+    id0_ = id;
+    t0_ += dy;
+    solve();
+}
@@ -0,0 +1,107 @@
+/**********************************************************
+device_watch.cpp
+
+Description:
+  inotify based wait for a serial device to reappear
+  after a USB reset or unplug
+
+*/
+
+#include "device_watch.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+// retry the device even without an inotify event this often
+#define DEVICE_WATCH_RETRY_MS 500
+
+
+device_watch::~device_watch()
+{
+    close();
+}
+
+int device_watch::watch(const char *path)
+{
+    close();
+    strncpy(path_, path, sizeof(path_) - 1);
+    path_[sizeof(path_) - 1] = '\0';
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0)
+        return -1;
+    return arm();
+}
+
+void device_watch::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    wd_ = -1;
+    backoff_ = false;
+}
+
+// watch the deepest directory on the path that currently exists
+int device_watch::arm()
+{
+    char dir[PATH_MAX];
+    strcpy(dir, path_);
+
+    if (wd_ >= 0)
+        inotify_rm_watch(fd_, wd_);
+    wd_ = -1;
+
+    while (wd_ < 0)
+    {
+        char *slash = strrchr(dir, '/');
+        if (!slash)
+            return -1;
+        if (slash == dir)
+            slash[1] = '\0';
+        else
+            *slash = '\0';
+
+        wd_ = inotify_add_watch(fd_, dir, IN_CREATE | IN_MOVED_TO | IN_ATTRIB);
+        if (wd_ < 0 && errno != ENOENT && errno != ENOTDIR)
+            return -1;
+        if (slash == dir)
+            break;
+    }
+    return wd_ < 0 ? -1 : 0;
+}
+
+int device_watch::wait(int timeout_ms)
+{
+    if (!backoff_ && access(path_, R_OK | W_OK) == 0)
+        return 1;
+    backoff_ = false;
+
+    int wait_ms = timeout_ms;
+    if (wait_ms < 0 || wait_ms > DEVICE_WATCH_RETRY_MS)
+        wait_ms = DEVICE_WATCH_RETRY_MS;
+
+    // without inotify fall back to polling the path
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int r = poll(fd_ >= 0 ? &pfd : NULL, fd_ >= 0 ? 1 : 0, wait_ms);
+    if (r < 0 && errno != EINTR)
+        return -1;
+
+    if (r > 0 && fd_ >= 0)
+    {
+        // drain events; an intermediate directory may have been created,
+        // so move the watch down the path before checking the device
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (read(fd_, events, sizeof(events)) > 0)
+            ;
+        arm();
+    }
+    return access(path_, R_OK | W_OK) == 0 ? 1 : 0;
+}
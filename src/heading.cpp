@@ -6,7 +6,7 @@ Description:
   the Gizmo 2 board to the Tegra X1
 
 */
-char *use_msg =
+const char *use_msg =
 "Usage:\n"
 "  heading [OPTIONS] [-d /dev/path]\n\n"
 
@@ -14,14 +14,17 @@ char *use_msg =
 "    begins a service and opens the serial device on the\n"
 "    specified path\n"
 "  -r, --read\n"
-"    an example code reading from the FIFO to obtain\n"
-"    heading data\n"
+"    an example client printing every heading as the\n"
+"    service receives it\n"
 "  -e, --elevation=angle\n"
 "    send elevation data supplied to the service for\n"
 "    transmission\n"
 "  -a, --azimuth=angle\n"
 "    send azimuth data supplied to the service for\n"
 "    transmission\n"
+"  -c, --checksum\n"
+"    append a checksum to every frame sent by the service\n"
+"    and ignore received frames without a valid one\n"
 "  -k, --kill\n"
 "    kill the service\n"
 "  -v, --verbose\n"
@@ -32,8 +35,9 @@ char *use_msg =
 "note:\n"
 "  1. before using any options the service must be started\n"
 "     using the 'd' or 'device' option\n"
-"  2. data received by the service can be accessed by\n"
-"     reading from the FIFO located at /tmp/headingfifo\n\n"
+"  2. data received by the service can be accessed with the\n"
+"     client library in heading_client.h, or by reading from\n"
+"     the FIFO located at /tmp/headingfifo\n\n"
 
 "Example (transmit)\n"
 "  heading --device=/dev/ttyUSB0\n"
@@ -53,11 +57,14 @@ char *use_msg =
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <math.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <ros/ros.h>
+#include "sentence.h"
+#include "heading_client.h"
+#include "rfdf_parser.h"
 
 
 
@@ -85,21 +92,30 @@ static int read_flag = 0;
 static int send_flag = 0;
 static int kill_flag = 0;
 static int verbose_flag = 0;
+static int checksum_flag = 0;
 
-// variable storage for command line options
-static char elevation_data[BUF_SIZE];
-static char azimuth_data[BUF_SIZE];
-static char device[BUF_SIZE];
+// heading data structure; valid has a HEADING_* bit per angle set
+#define HEADING_AZIMUTH 1
+#define HEADING_ELEVATION 2
+#define HEADING_BOTH (HEADING_AZIMUTH | HEADING_ELEVATION)
 
-// heading data structure
 typedef struct
 {
-  char azimuth[BUF_SIZE];
-  char elevation[BUF_SIZE];
+  float azimuth;
+  float elevation;
+  int valid;
 } heading_struct;
 
-// data received is stored and overwritten here
+// variable storage for command line options
+static heading_struct options;
+static char device[BUF_SIZE];
+
+// heading to transmit, set through the FIFO
 heading_struct angles;
+// heading received over the serial port
+heading_struct received;
+// id of the next transmitted frame
+int32_t tx_id = 0;
 
 // headers for data transmission
 char azimuth_header[] = "AZIMUTH";
@@ -112,7 +128,7 @@ char elevation_header[] = "ELEVATION";
 // print usage
 void print_usage()
 {
-  printf(use_msg);
+  printf("%s", use_msg);
 }
 
 void print_options()
@@ -121,10 +137,10 @@ void print_options()
   printf("----------------------\n");
   if (strlen(device) > 0)
     printf("Device: %s\n", device);
-  if (strlen(elevation_data) > 0)
-    printf("Elevation: %s\n", elevation_data);
-  if (strlen(azimuth_data) > 0)
-    printf("Azimuth: %s\n", azimuth_data);
+  if (options.valid & HEADING_ELEVATION)
+    printf("Elevation: %.1f\n", options.elevation);
+  if (options.valid & HEADING_AZIMUTH)
+    printf("Azimuth: %.1f\n", options.azimuth);
   if (initialize_flag)
     printf("Opening serial device.\n");
   if (read_flag)
@@ -134,6 +150,35 @@ void print_options()
 }
 
 
+// --------------------------------------------------------
+// Angle validation
+
+// parse a whole string as an angle in [min, max]; returns 0 on success
+int parse_angle(const char *str, float min, float max, float *angle)
+{
+  char *end;
+  errno = 0;
+  float a = strtof(str, &end);
+  // allow trailing separators and whitespace, nothing else
+  while (*end == ';' || *end == '\n' || *end == '\r' || *end == ' ')
+    end++;
+  if (end == str || *end != '\0' || errno || !isfinite(a) || a < min || a > max)
+    return -1;
+  *angle = a;
+  return 0;
+}
+
+int parse_azimuth(const char *str, float *azimuth)
+{
+  return parse_angle(str, -360, 360, azimuth);
+}
+
+int parse_elevation(const char *str, float *elevation)
+{
+  return parse_angle(str, -90, 90, elevation);
+}
+
+
 // --------------------------------------------------------
 // Initialization functions
 
@@ -183,44 +228,37 @@ void configure_serial()
 // --------------------------------------------------------
 // Data transfer TO the serial port or the fifo
 
+// one EAI frame per heading, in a single write so the receiver never
+// sees the azimuth of one heading with the elevation of another
 void send_data_serial()
 {
-  int azimuth_len = strlen(angles.azimuth);
-  int elevation_len = strlen(angles.elevation);
-  if (azimuth_len < 1 || elevation_len < 1)
-    return;
   char data[BUF_SIZE];
-  // transmit azimuth data
-  sprintf(data, "%s%s\n", azimuth_header, angles.azimuth);
-  write(tty_fd, data, strlen(data));
-  if (verbose_flag)
-    printf("Sending %s over serial port.\n", data);
-  // transmit elevation data
-  sprintf(data, "%s%s\n", elevation_header, angles.elevation);
-  write(tty_fd, data, strlen(data));
+  if (angles.valid != HEADING_BOTH)
+    return;
+  int len = rfdf_encode(data, BUF_SIZE, angles.elevation, angles.azimuth, tx_id++, checksum_flag);
+  write(tty_fd, data, len);
   if (verbose_flag)
     printf("Sending %s over serial port.\n", data);
 }
 
-void send_data_fifo(int send)
+// the heading and the optional SEND command in a single FIFO write
+void send_data_fifo(const heading_struct *h, int send)
 {
   char data[BUF_SIZE];
-  
+  int len = 0;
+
   if (verbose_flag)
     printf("Sending data to FIFO.\n");
   create_fifo();
 
-  sprintf(data, "%s%s\n", elevation_header, elevation_data);
-  write(fifo_fd, data, strlen(data));
-
-  sprintf(data, "%s%s\n", azimuth_header, azimuth_data);
-  write(fifo_fd, data, strlen(data));
-  
+  if (h->valid & HEADING_ELEVATION)
+    len += snprintf(data + len, BUF_SIZE - len, "%s%.1f\n", elevation_header, h->elevation);
+  if (h->valid & HEADING_AZIMUTH)
+    len += snprintf(data + len, BUF_SIZE - len, "%s%.1f\n", azimuth_header, h->azimuth);
   if (send)
-  {
-    sprintf(data, "SEND\n");
-    write(fifo_fd, data, strlen(data));
-  }
+    len += snprintf(data + len, BUF_SIZE - len, "SEND\n");
+  if (len > 0)
+    write(fifo_fd, data, len);
 }
 
 void send_fifo_kill()
@@ -235,143 +273,147 @@ void send_fifo_kill()
 // --------------------------------------------------------
 // Data transfer FROM the serial port or the fifo
 
+// example client: sleeps until the service publishes a new heading
 void read_data_fifo()
 {
-  char buf[BUF_SIZE];
-  int cr;
+  struct heading_sample h;
 
-  create_fifo();
+  if (heading_open() < 0)
+  {
+    printf("Error: Could not open the shared heading - %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
 
   while (1) {
-    // read from fifo
-    memset(buf, 0, BUF_SIZE);
-    cr = read(fifo_fd, &buf, BUF_SIZE);
-    // output to stdout
-    if (cr > 0)
-    {
-      FILE *file = fmemopen(buf, strlen(buf), "r");
-      char line[BUF_SIZE];
-      char tmp[BUF_SIZE];
-      char data[BUF_SIZE];
-      int r;
-      while (fgets(line, BUF_SIZE, file))
-      {
-        // look for Elevation data
-        strcpy(tmp, elevation_header);
-        strcat(tmp, "%s\n");
-        r = sscanf(line, tmp, data);
-        if (r > 0)
-          printf("Elevation: %s\n", data);
-
-        // look for Azimuth data
-        strcpy(tmp, azimuth_header);
-        strcat(tmp, "%s\n");
-        r = sscanf(line, tmp, data);
-        if (r > 0)
-          printf("Azimuth: %s\n", data);
-      }
-    }
-    // sleep
-    usleep(10000);
+    if (heading_wait_next(&h, -1) < 0)
+      continue;
+    printf("Elevation: %.1f\n", h.elevation);
+    printf("Azimuth: %.1f\n", h.azimuth);
   }
 }
 
 void process_data(char *buf)
 {
-  char tmp[BUF_SIZE];
-  char msg[BUF_SIZE];
-  int r;
+  size_t header_len;
+  rfdf_frame frame;
   int send = 0;
+  // angles received in this batch; received.valid also holds older ones
+  int updated = 0;
   char line[BUF_SIZE];
   FILE *file = fmemopen(buf, strlen(buf), "r");
   while(fgets(line, BUF_SIZE, file))
   {
     if (verbose_flag)
       printf("Serial Message: %s", line);
-    
-    // Look for Elevation data
-    strcpy(tmp, elevation_header);
-    strcat(tmp, "%s\n");
-    r = sscanf(line, tmp, msg);
-    if (r > 0)
+
+    // lines failing their checksum are dropped like any garbled line;
+    // with --checksum a frame must carry one
+    int type = sentence_lookup(line, strlen(line), &header_len);
+    rfdf_checksum check = rfdf_parser::check(line, strlen(line));
+    if (check == CHECKSUM_BAD || (check == CHECKSUM_NONE && checksum_flag && type == SENTENCE_EAI))
     {
       if (verbose_flag)
-        printf("Elevation: %s\n", msg);
-      strcpy(elevation_data, msg);
-      send = 1;
+        printf("Dropped, bad checksum.\n");
+      continue;
     }
-    
-    // Look for Azimuth data
-    strcpy(tmp, azimuth_header);
-    strcat(tmp, "%s\n");
-    r = sscanf(line, tmp, msg);
-    if (r > 0)
+
+    switch (type)
     {
-      if (verbose_flag)
-        printf("Azimuth: %s\n", msg);
-      strcpy(azimuth_data, msg);
-      send = 1;
+      case SENTENCE_EAI:
+        if (rfdf_parser::parse_eai(line + header_len, frame))
+        {
+          if (verbose_flag)
+            printf("Heading: %.1f, %.1f (%d)\n", frame.elevation, frame.azimuth, frame.id);
+          received.elevation = frame.elevation;
+          received.azimuth = frame.azimuth;
+          received.valid = HEADING_BOTH;
+          updated = HEADING_BOTH;
+          send = 1;
+        }
+        break;
+      case SENTENCE_ELEVATION:
+        if (parse_elevation(line + header_len, &received.elevation) == 0)
+        {
+          if (verbose_flag)
+            printf("Elevation: %.1f\n", received.elevation);
+          received.valid |= HEADING_ELEVATION;
+          updated |= HEADING_ELEVATION;
+          send = 1;
+        }
+        break;
+      case SENTENCE_AZIMUTH:
+        if (parse_azimuth(line + header_len, &received.azimuth) == 0)
+        {
+          if (verbose_flag)
+            printf("Azimuth: %.1f\n", received.azimuth);
+          received.valid |= HEADING_AZIMUTH;
+          updated |= HEADING_AZIMUTH;
+          send = 1;
+        }
+        break;
+      default:
+        break;
     }
   }
+  fclose(file);
   if (send)
-    send_data_fifo(0);
+  {
+    // clients get whole headings only, never one angle with a stale other:
+    // an EAI frame, or both legacy lines in the same batch
+    if (updated == HEADING_BOTH)
+      heading_publish(received.azimuth, received.elevation);
+    send_data_fifo(&received, 0);
+  }
 }
 
 void process_fifo(char *buf)
 {
-  char tmp[BUF_SIZE];
-  char msg[BUF_SIZE];
-  float data;
-  int r;
-  char *ret;
+  size_t header_len;
   char line[BUF_SIZE];
   FILE *file = fmemopen(buf, strlen(buf), "r");
   while (fgets(line, BUF_SIZE, file))
   {
     if (verbose_flag)
       printf("FIFO Message: %s", line);
-    
-    // Look for Elevation data
-    strcpy(tmp, elevation_header);
-    strcat(tmp, "%s\n");
-    r = sscanf(line, tmp, msg);
-    if (r > 0)
-    {
-      if (verbose_flag)
-        printf("Elevation: %s\n", msg);
-      strcpy(angles.elevation, msg);
-    }
-    
-    // Look for Azimuth data
-    strcpy(tmp, azimuth_header);
-    strcat(tmp, "%s\n");
-    r = sscanf(line, tmp, msg);
-    if (r > 0)
-    {
-      if (verbose_flag)
-        printf("Azimuth: %s\n", msg);
-      strcpy(angles.azimuth, msg);
-    }
-    
-    // Look for Send command
-    ret = strstr(line, "SEND\n");
-    if (ret)
-    {
-      if (verbose_flag)
-        printf("Found SEND\n");
-      send_data_serial();
-    }
 
-    // Look for Kill command
-    ret = strstr(line, "K\n");
-    if (ret)
+    switch (sentence_lookup(line, strlen(line), &header_len))
     {
-      if (verbose_flag)
-        printf("Found Kill\n");
-      close_connection();
-      exit(EXIT_SUCCESS);
+      case SENTENCE_ELEVATION:
+        if (parse_elevation(line + header_len, &angles.elevation) == 0)
+        {
+          if (verbose_flag)
+            printf("Elevation: %.1f\n", angles.elevation);
+          angles.valid |= HEADING_ELEVATION;
+        }
+        else
+          printf("Warning: Ignoring invalid elevation %s", line + header_len);
+        break;
+      case SENTENCE_AZIMUTH:
+        if (parse_azimuth(line + header_len, &angles.azimuth) == 0)
+        {
+          if (verbose_flag)
+            printf("Azimuth: %.1f\n", angles.azimuth);
+          angles.valid |= HEADING_AZIMUTH;
+        }
+        else
+          printf("Warning: Ignoring invalid azimuth %s", line + header_len);
+        break;
+      case SENTENCE_SEND:
+        if (verbose_flag)
+          printf("Found SEND\n");
+        send_data_serial();
+        break;
+      case SENTENCE_KILL:
+        if (verbose_flag)
+          printf("Found Kill\n");
+        fclose(file);
+        close_connection();
+        exit(EXIT_SUCCESS);
+      default:
+        break;
     }
   }
+  fclose(file);
 }
 
 void main_loop()
@@ -380,6 +422,8 @@ void main_loop()
   int cr;
 //  configure_serial();   ###################### I commented this out for testing.
   create_fifo();
+  if (heading_publisher_open() < 0)
+    printf("Warning: Could not create the shared heading - %s\n", strerror(errno));
 
   while (1) {
     // read from fifo
@@ -421,13 +465,14 @@ void parse_options(int argc, char** argv)
       {"read", no_argument,             &read_flag, 1},
       {"elevation", required_argument,         0, 'e'},
       {"azimuth", required_argument,           0, 'a'},
+      {"checksum", no_argument,     &checksum_flag, 1},
       {"kill", no_argument,             &kill_flag, 1},
       {"verbose", no_argument,       &verbose_flag, 1},
       {"help", no_argument,                    0, 'h'}
     };
 
     int option_index = 0;
-    c = getopt_long(argc, argv, "d:re:a:kvh", lopts, &option_index);
+    c = getopt_long(argc, argv, "d:re:a:ckvh", lopts, &option_index);
 
     // end of options
     if (c == -1)
@@ -445,13 +490,26 @@ void parse_options(int argc, char** argv)
         read_flag = 1;
         break;
       case 'e':
-        strcpy(elevation_data, optarg);
+        if (parse_elevation(optarg, &options.elevation) < 0)
+        {
+          printf("Error: Invalid elevation %s, expected -90 to 90 degrees.\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        options.valid |= HEADING_ELEVATION;
         send_flag = 1;
         break;
       case 'a':
-        strcpy(azimuth_data, optarg);
+        if (parse_azimuth(optarg, &options.azimuth) < 0)
+        {
+          printf("Error: Invalid azimuth %s, expected -360 to 360 degrees.\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        options.valid |= HEADING_AZIMUTH;
         send_flag = 1;
         break;
+      case 'c':
+        checksum_flag = 1;
+        break;
       case 'k':
         kill_flag = 1;
         break;
@@ -534,7 +592,7 @@ int main(int argc, char** argv)
     if (send_flag)
     {
       // send data message
-      send_data_fifo(1);
+      send_data_fifo(&options, 1);
     }
     if (read_flag)
     {
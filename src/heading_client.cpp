@@ -0,0 +1,269 @@
+/**********************************************************
+heading_client.cpp
+
+Description:
+  Shared memory heading published by the heading service,
+  with futex wake up of waiting clients
+
+*/
+
+#include "heading_client.h"
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define HEADING_SHM_NAME "/heading"
+// reads of an odd sequence number before giving up; an update takes well
+// under a microsecond, so only a service that died mid update gets here
+#define HEADING_READ_RETRIES 100000
+
+// layout of /dev/shm/heading; seq is odd while the service is writing
+struct heading_shm
+{
+    uint32_t seq;
+    uint32_t waiters;
+    float azimuth;
+    float elevation;
+    double stamp;
+};
+
+static struct heading_shm *shm = NULL;
+static uint32_t last_seq = 0;
+
+static pthread_t callback_thread;
+static int callback_running = 0;
+static int callback_stop = 0;
+static heading_callback callback_fn = NULL;
+static void *callback_arg = NULL;
+
+
+static int futex(uint32_t *addr, int op, uint32_t val, const struct timespec *timeout)
+{
+    return (int)syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static double monotonic_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int map_shm(int flags)
+{
+    if (shm)
+        return 0;
+    int fd = shm_open(HEADING_SHM_NAME, flags, 0666);
+    if (fd < 0)
+        return -1;
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof(struct heading_shm)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(struct heading_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    shm = (struct heading_shm *)map;
+    return 0;
+}
+
+// consistent copy of the shared heading; returns its sequence number, or
+// an odd number if the service was writing
+static uint32_t read_sample(struct heading_sample *sample)
+{
+    uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+        return seq;
+    sample->azimuth = shm->azimuth;
+    sample->elevation = shm->elevation;
+    sample->stamp = shm->stamp;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) != seq)
+        return 1;
+    sample->seq = seq / 2;
+    return seq;
+}
+
+// wait for a sequence number other than last
+static int wait_after(uint32_t last, struct heading_sample *sample, int timeout_ms)
+{
+    double deadline = monotonic_now() + timeout_ms * 1e-3;
+
+    if (!shm)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    while (1)
+    {
+        uint32_t seq = read_sample(sample);
+        if (!(seq & 1) && seq != last)
+            return 0;
+
+        struct timespec ts, *tsp = NULL;
+        if (timeout_ms >= 0)
+        {
+            double left = deadline - monotonic_now();
+            if (left <= 0)
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            ts.tv_sec = (time_t)left;
+            ts.tv_nsec = (long)((left - ts.tv_sec) * 1e9);
+            tsp = &ts;
+        }
+        // the service only issues a wake up if it sees a waiter
+        __atomic_add_fetch(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shm->seq, __ATOMIC_SEQ_CST) == seq)
+            futex(&shm->seq, FUTEX_WAIT, seq, tsp);
+        __atomic_sub_fetch(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void *callback_loop(void *)
+{
+    struct heading_sample sample;
+    uint32_t last = 0;
+
+    while (!__atomic_load_n(&callback_stop, __ATOMIC_ACQUIRE))
+    {
+        if (wait_after(last, &sample, 100) == 0)
+        {
+            last = sample.seq * 2;
+            callback_fn(&sample, callback_arg);
+        }
+    }
+    return NULL;
+}
+
+
+// --------------------------------------------------------
+// Client
+
+int heading_open(void)
+{
+    if (map_shm(O_RDWR) < 0)
+        return -1;
+    last_seq = 0;
+    return 0;
+}
+
+void heading_close(void)
+{
+    heading_set_callback(NULL, NULL);
+    if (shm)
+        munmap(shm, sizeof(struct heading_shm));
+    shm = NULL;
+}
+
+int heading_get_latest(struct heading_sample *sample)
+{
+    if (!shm)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    uint32_t seq;
+    int retries = 0;
+    while ((seq = read_sample(sample)) & 1)
+    {
+        if (++retries == HEADING_READ_RETRIES)
+        {
+            errno = EBUSY;
+            return -1;
+        }
+    }
+    if (seq == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    last_seq = seq;
+    return 0;
+}
+
+int heading_wait_next(struct heading_sample *sample, int timeout_ms)
+{
+    if (wait_after(last_seq, sample, timeout_ms) < 0)
+        return -1;
+    last_seq = sample->seq * 2;
+    return 0;
+}
+
+int heading_set_callback(heading_callback cb, void *arg)
+{
+    if (callback_running)
+    {
+        __atomic_store_n(&callback_stop, 1, __ATOMIC_RELEASE);
+        pthread_join(callback_thread, NULL);
+        callback_running = 0;
+    }
+    if (!cb)
+        return 0;
+    if (!shm)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    callback_fn = cb;
+    callback_arg = arg;
+    callback_stop = 0;
+    int r = pthread_create(&callback_thread, NULL, callback_loop, NULL);
+    if (r)
+    {
+        errno = r;
+        return -1;
+    }
+    callback_running = 1;
+    return 0;
+}
+
+
+// --------------------------------------------------------
+// Service
+
+int heading_publisher_open(void)
+{
+    if (map_shm(O_RDWR | O_CREAT) < 0)
+        return -1;
+    // a service that crashed mid update left seq odd, which would hang
+    // readers and invert the parity of every later update
+    uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    if (seq & 1)
+    {
+        __atomic_store_n(&shm->seq, (seq + 1) & ~1u, __ATOMIC_SEQ_CST);
+        futex(&shm->seq, FUTEX_WAKE, INT32_MAX, NULL);
+    }
+    return 0;
+}
+
+void heading_publish(float azimuth, float elevation)
+{
+    struct timespec ts;
+    if (!shm)
+        return;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shm->azimuth = azimuth;
+    shm->elevation = elevation;
+    shm->stamp = ts.tv_sec + 1e-9 * ts.tv_nsec;
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&shm->waiters, __ATOMIC_SEQ_CST))
+        futex(&shm->seq, FUTEX_WAKE, INT32_MAX, NULL);
+}
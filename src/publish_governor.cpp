@@ -0,0 +1,111 @@
+/**********************************************************
+publish_governor.cpp
+
+Description:
+  Overload control between the parser and the ROS
+  publishers
+
+*/
+
+#include "publish_governor.h"
+
+// batches to wait after a switch before the next one
+#define GOVERNOR_HOLD 50
+// weight of the newest publish latency in the moving average
+#define GOVERNOR_ALPHA 0.1
+
+
+void publish_governor::configure(publish_policy policy, int decimate, double latest_period,
+                                 double latency_high, double latency_low)
+{
+    mode_ = policy;
+    decimate_ = decimate > 1 ? decimate : 1;
+    latest_period_ = latest_period;
+    latency_high_ = latency_high;
+    latency_low_ = latency_low;
+    current_ = policy == PUBLISH_AUTO ? PUBLISH_ALL : policy;
+    subscribers_ = -1;
+    latency_ = 0;
+    hold_ = 0;
+}
+
+const char *publish_governor::name(publish_policy policy)
+{
+    switch (policy)
+    {
+    case PUBLISH_ALL:
+        return "all";
+    case PUBLISH_DECIMATE:
+        return "decimate";
+    case PUBLISH_LATEST:
+        return "latest";
+    default:
+        return "auto";
+    }
+}
+
+void publish_governor::set(publish_policy policy)
+{
+    if (policy == current_)
+        return;
+    current_ = policy;
+    switches_++;
+    hold_ = GOVERNOR_HOLD;
+}
+
+bool publish_governor::begin(int subscribers, double now)
+{
+    now_ = now;
+    if (mode_ == PUBLISH_AUTO && subscribers != subscribers_)
+    {
+        // the cost of a publish changed: probe again from full fidelity
+        set(PUBLISH_ALL);
+        latency_ = 0;
+        hold_ = 0;
+    }
+    subscribers_ = subscribers;
+    return subscribers > 0;
+}
+
+bool publish_governor::admit(int i, int n)
+{
+    bool ok;
+
+    switch (current_)
+    {
+    case PUBLISH_DECIMATE:
+        ok = count_++ % decimate_ == 0;
+        break;
+    case PUBLISH_LATEST:
+        ok = i == n - 1 && now_ - last_latest_ >= latest_period_;
+        if (ok)
+            last_latest_ = now_;
+        break;
+    default:
+        ok = true;
+        break;
+    }
+    if (!ok)
+        dropped_++;
+    return ok;
+}
+
+void publish_governor::published(int m, double seconds)
+{
+    if (m <= 0)
+        return;
+    double per_frame = seconds / m;
+    latency_ = latency_ == 0 ? per_frame : latency_ + GOVERNOR_ALPHA * (per_frame - latency_);
+
+    if (mode_ != PUBLISH_AUTO)
+        return;
+    if (hold_ > 0)
+    {
+        hold_--;
+        return;
+    }
+    if (latency_ > latency_high_ && current_ != PUBLISH_LATEST)
+        set(current_ == PUBLISH_ALL ? PUBLISH_DECIMATE : PUBLISH_LATEST);
+    else if (latency_ < latency_low_ && current_ != PUBLISH_ALL)
+        set(current_ == PUBLISH_LATEST ? PUBLISH_DECIMATE : PUBLISH_ALL);
+}
@@ -1,230 +1,654 @@
-/**********************************************************
-rfdf.cpp
-
-Description:
-  Useful for transferring heading data from
-  the Gizmo 2 board to ROS system
-
-*/
-
-#include "rfdf.h"
-
-
-// --------------------------------------------------------
-// Serial: Configure serial port and set up listener
-
-
-rfdf::rfdf()
-{
-
-    rfdf_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf", 1);
-
-}
-
-void rfdf::ros_publish(float el, float az, int id)
-{
-    geometry_msgs::Vector3Stamped msg;
-    uint32_t id_u = (uint32_t)id;
-    msg.header.seq = id;
-    msg.vector.x = 0;
-    msg.vector.y = el;
-    msg.vector.z = az;
-
-    rfdf_pub_.publish(msg);
-
-}
-
-void rfdf::configure_serial()
-{
-    struct termios tio;
-    char c = 0x00;
-
-    memset(&tio, 0, sizeof(tio));
-    tio.c_iflag = 0;
-    tio.c_oflag = 0;
-    tio.c_cflag = CS8 | CREAD | CLOCAL;
-    tio.c_lflag = 0;
-    tio.c_cc[VMIN] = 1;
-    tio.c_cc[VTIME] = 5;
-    cfsetospeed(&tio, B115200);
-    cfsetispeed(&tio, B115200);
-
-    tty_fd = open(device, O_RDWR | O_NONBLOCK);
-    if (tty_fd < 0)
-    {
-        printf("Error: Failed to open serial port - %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    tcsetattr(tty_fd, TCSANOW, &tio);
-}
-
-// send serial data (used only by Gizmo)
-void rfdf::send_data_serial(float elevation, float azimuth, int id)
-{
-    // create serial message
-    char msg[BUF_SIZE];
-    sprintf(msg, "EAI%08.1f,%08.1f,%010d;\n", elevation, azimuth, id);
-
-    // debug: display message
-    std::cout << msg << std::endl;
-
-    // transmit message
-    write(tty_fd, msg, strlen(msg));
-}
-
-// read serial data main loop
-void rfdf::main_loop()
-{
-    char buf[BUF_SIZE];
-    int cr;
-
-    configure_serial();
-
-    while (1)
-    {
-        // read from serial port
-        memset(buf, 0, BUF_SIZE);
-        cr = read(tty_fd, &buf, BUF_SIZE);
-        // process input from serial data
-        if (cr > 0)
-            process_serial_data(buf, cr);
-        // sleep for 10 ms
-        serial_sleep(10);
-    }
-}
-
-void rfdf::process_serial_data(char *buf, int cr)
-{
-    char fmt[BUF_SIZE];
-    char line[BUF_SIZE];
-    FILE *file = fmemopen(buf, strlen(buf), "r");
-    float elevation;
-    float azimuth;
-    int id;
-
-    while (fgets(line, BUF_SIZE, file))
-    {
-        // look for serial message header
-        int r = sscanf(line, "EAI%f,%f,%d;\n", &elevation, &azimuth, &id);
-        if (r > 0)
-        {
-            // found a message
-            std::cout << "EAI " << elevation << "," << azimuth << "," << id;
-            ros_publish(elevation, azimuth, id);
-        }
-    }
-}
-
-
-// --------------------------------------------------------
-// Other: Miscellaneous functions
-
-void rfdf::serial_sleep(int milliseconds)
-{
-    struct timespec req = {0};
-    req.tv_sec = 0;
-    req.tv_nsec = milliseconds * 1000000L;
-    nanosleep(&req, (struct timespec *)NULL);
-}
-
-void rfdf::test_transmit_loop()
-{
-    configure_serial();
-
-    for (int i = 0; i < 100; i++)
-    {
-        double elevation = i + 0.1;
-        double azimuth = 100 - i + 0.2;
-        int id = i;
-        // transmit one message
-        send_data_serial(elevation, azimuth, id);
-
-        // pause for 10 ms
-        serial_sleep(10);
-    }
-}
-
-void rfdf::parse_options(int argc, char** argv)
-{
-    int c;
-
-    while (1)
-    {
-        static struct option lopts[] =
-        {
-        {"device", required_argument,            0, 'd'},
-        {"test",   no_argument,       &run_test_flag, 1},
-        {"help",   no_argument,                  0, 'h'}
-    };
-
-        int option_index = 0;
-        c = getopt_long(argc, argv, "d:th", lopts, &option_index);
-
-        // end of options
-        if (c == -1)
-            break;
-
-        switch (c)
-        {
-        case 0:
-            break;
-        case 'd':
-            device_flag = 1;
-            strcpy(device, optarg);
-            break;
-        case 't':
-            run_test_flag = 1;
-            break;
-        case 'h':
-            //print_usage();
-            exit(EXIT_SUCCESS);
-            break;
-        case '?':
-            printf("Error: Invalid option.\n");
-            //print_usage();
-            exit(EXIT_FAILURE);
-        default:
-            printf("Error: Invalid option %c.\n", c);
-            //print_usage();
-            exit(EXIT_FAILURE);
-        }
-    }
-}
-
-
-// --------------------------------------------------------
-// main: entrance point for the program
-
-int main(int argc, char** argv)
-{
-
-    ros::init(argc, argv, "rfdf_node");
-    rfdf class_obj;
-
-    // process input arguments
-//    class_obj.parse_options(argc, argv);
-//    class_obj.run_test_flag = 1;
-    class_obj.device_flag = 1;
-    class_obj.device = "/dev/ttyUSB1";
-
-
-    if (!class_obj.device_flag)
-    {
-        std::cout << "Device option required." << std::endl;
-        return EXIT_FAILURE;
-    }
-
-    // run test loop
-    if (class_obj.run_test_flag)
-    {
-        class_obj.test_transmit_loop();
-    }
-
-    // run main loop
-    if (!class_obj.run_test_flag)
-    {
-        class_obj.main_loop();
-    }
-
-    return EXIT_SUCCESS;
-}
+/**********************************************************
+rfdf.cpp
+
+Description:
+  Useful for transferring heading data from
+  the Gizmo 2 board to ROS system
+
+*/
+
+#include "rfdf.h"
+
+
+// --------------------------------------------------------
+// Serial: Configure serial port and set up listener
+
+
+rfdf::rfdf()
+    : tf_listener_(tf_buffer_), spinner_(1)
+{
+    ros::NodeHandle pnh("~");
+    double half_life, gate;
+    pnh.param("clock_sync", receiver_.clock_sync_enabled_, true);
+    pnh.param("clock_sync_half_life", half_life, 500.0);
+    pnh.param("clock_sync_gate", gate, 4.0);
+    receiver_.clock_ = clock_sync(half_life, gate);
+
+    // ~checksum: send *HH checksums and drop received sentences without one
+    pnh.param("checksum", receiver_.parser_.require_checksum_, false);
+
+    // settings that can also change at run time, see cfg/Rfdf.cfg; "hybrid"
+    // spins on the port for up to ~busy_poll_us after each frame, and the
+    // overload policy decides what is published when subscribers lag
+    rfdf_settings s;
+    pnh.param<std::string>("io_backend", s.io_backend, "epoll");
+    pnh.param("busy_poll_us", s.busy_poll_us, RFDF_IO_SPIN_US);
+    pnh.param("sleep_ms", s.sleep_ms, RFDF_IO_SLEEP_US / 1000);
+    pnh.param("read_size", s.read_size, BUF_SIZE);
+    pnh.param("max_batch", s.max_batch, RFDF_MAX_BATCH);
+    pnh.param<std::string>("overload_policy", s.overload_policy, "auto");
+    pnh.param("decimate", s.decimate, 4);
+    pnh.param("latest_period", s.latest_period, 0.1);
+    pnh.param("publish_latency_high", s.publish_latency_high, 2e-4);
+    pnh.param("publish_latency_low", s.publish_latency_low, 5e-5);
+    pnh.param("baud", s.baud, 115200);
+    pnh.param<std::string>("log_level", s.log_level, "info");
+    pnh.param("echo_frames", s.echo_frames, false);
+    settings_changed_ = false;
+    apply_settings(s);
+
+    int window;
+    double smoothing_gate;
+    pnh.param("smoothing", smoothing_, false);
+    pnh.param("smoothing_window", window, 10);
+    pnh.param("smoothing_gate", smoothing_gate, 0.0);
+    el_filter_.configure(window, smoothing_gate);
+    az_filter_.configure(window, smoothing_gate);
+
+    pnh.param("direction", direction_, false);
+    pnh.param<std::string>("frame_id", frame_id_, "rfdf");
+    pnh.param<std::string>("target_frame", target_frame_, "");
+
+    // ~trace_file starts the built-in tracer, see rfdf_trace.h
+    pnh.param<std::string>("trace_file", trace_file_, "");
+    if (!trace_file_.empty())
+    {
+#ifdef RFDF_TRACE_ENABLED
+        rfdf_trace_start(trace_file_.c_str());
+#else
+        printf("Warning: ~trace_file is set but tracing was not built in (RFDF_TRACE=OFF).\n");
+#endif
+    }
+
+    std::string log_file;
+    pnh.param<std::string>("log_file", log_file, "");
+    pnh.param("device_id", device_id_, 0);
+    if (!log_file.empty() && log_.open(log_file.c_str()) < 0)
+        printf("Error: Failed to open bearing log %s - %s\n", log_file.c_str(), strerror(errno));
+
+    // ~udp_group enables the sink; ~udp_destinations adds unicast receivers
+    std::string udp_group, udp_interface;
+    std::vector<std::string> udp_destinations;
+    int udp_port, udp_ttl;
+    pnh.param<std::string>("udp_group", udp_group, "");
+    pnh.param("udp_port", udp_port, UDP_BEARING_PORT);
+    pnh.param("udp_ttl", udp_ttl, 1);
+    pnh.param<std::string>("udp_interface", udp_interface, "");
+    pnh.param("udp_destinations", udp_destinations, std::vector<std::string>());
+    if (!udp_group.empty())
+        udp_destinations.insert(udp_destinations.begin(), udp_group);
+    for (size_t i = 0; i < udp_destinations.size(); i++)
+        if (udp_.open(udp_destinations[i].c_str(), udp_port, udp_ttl, udp_interface.c_str()) < 0)
+            printf("Error: Failed to open UDP output to %s:%d - %s\n", udp_destinations[i].c_str(),
+                   udp_port, strerror(errno));
+    udp_.set_device(device_id_);
+
+    // ~tracker extrapolates the bearing to any time for gimbal control
+    double accel_noise, bearing_sigma, track_timeout;
+    pnh.param("tracker", tracking_, false);
+    pnh.param("tracker_accel_noise", accel_noise, 100.0);
+    pnh.param("tracker_bearing_sigma", bearing_sigma, 2.0);
+    pnh.param("tracker_timeout", track_timeout, 1.0);
+    if (tracking_)
+    {
+        tracker_ = bearing_tracker(accel_noise, bearing_sigma, track_timeout);
+        if (tracker_shm_.create(device_id_) < 0)
+        {
+            printf("Error: Failed to share the tracker of device %d - %s\n", device_id_, strerror(errno));
+            tracker_shm_.create(-1);
+        }
+        tracker_service_.advertise(pnh, "predict_bearing", &tracker_shm_);
+    }
+
+    // outgoing queue of every publisher; fixed once advertised
+    int queue_size;
+    pnh.param("queue_size", queue_size, 1);
+    rfdf_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf", queue_size);
+    if (direction_)
+        direction_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf_direction", queue_size);
+    if (!target_frame_.empty())
+        world_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf_world", queue_size);
+    if (smoothing_)
+    {
+        smoothed_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf_smoothed", queue_size);
+        variance_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("rfdf_variance", queue_size);
+    }
+
+    // the other Gizmo sentences, each on its own topic; channel and health
+    // change rarely, so they are latched
+    signal_pub_ = nh_.advertise<std_msgs::Float32>("rfdf_signal", queue_size);
+    channel_pub_ = nh_.advertise<std_msgs::UInt8>("rfdf_channel", 1, true);
+    health_pub_ = nh_.advertise<std_msgs::UInt32>("rfdf_health", 1, true);
+    receiver_.parser_.on<rfdf_signal>([this](const rfdf_signal &s)
+    {
+        std_msgs::Float32 msg;
+        msg.data = s.strength;
+        signal_pub_.publish(msg);
+    });
+    receiver_.parser_.on<rfdf_channel>([this](const rfdf_channel &c)
+    {
+        std_msgs::UInt8 msg;
+        msg.data = c.channel;
+        channel_pub_.publish(msg);
+    });
+    receiver_.parser_.on<rfdf_health>([this](const rfdf_health &h)
+    {
+        if (h.flags)
+            ROS_WARN_THROTTLE(10.0, "Gizmo reports fault flags 0x%x", h.flags);
+        std_msgs::UInt32 msg;
+        msg.data = h.flags;
+        health_pub_.publish(msg);
+    });
+
+    // changes arrive on the spinner thread and are applied by the read
+    // loop between two reads
+    reconfigure_.start(pnh, [this](const rfdf_settings &s)
+    {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        pending_settings_ = s;
+        settings_changed_.store(true, std::memory_order_release);
+    });
+    spinner_.start();
+}
+
+// apply s over the current settings without closing the port: the old I/O
+// backend stops reading ahead, and the bytes it has already read are
+// decoded before the new one takes over
+void rfdf::apply_settings(const rfdf_settings &s)
+{
+    std::string io_backend = settings_.io_backend;
+    int sleep_ms = std::max(1, s.sleep_ms);
+    // compared with the backend asked for, so a fallback is not retried on
+    // every later change of an unrelated setting
+    if (!receiver_.io_ || s.io_backend != io_requested_ ||
+        s.busy_poll_us != settings_.busy_poll_us || sleep_ms != settings_.sleep_ms)
+    {
+        if (receiver_.io_ && receiver_.port_.is_open())
+        {
+            char buf[RFDF_READ_MAX];
+            ssize_t cr;
+            receiver_.io_->cancel();
+            while ((cr = receiver_.io_->read(buf, sizeof(buf), 0)) > 0)
+                process_serial_data(buf, cr, ros::Time::now());
+        }
+        receiver_.set_io(s.io_backend.c_str(), s.busy_poll_us, sleep_ms * 1000);
+        io_requested_ = s.io_backend;
+        io_backend = receiver_.io_->name();
+        if (io_backend != s.io_backend)
+            ROS_WARN("I/O backend %s is not available, using %s.", s.io_backend.c_str(),
+                     io_backend.c_str());
+        printf("Using %s serial I/O.\n", io_backend.c_str());
+    }
+
+    publish_policy policy = PUBLISH_AUTO;
+    if (s.overload_policy == "all")
+        policy = PUBLISH_ALL;
+    else if (s.overload_policy == "decimate")
+        policy = PUBLISH_DECIMATE;
+    else if (s.overload_policy == "latest")
+        policy = PUBLISH_LATEST;
+    else if (s.overload_policy != "auto")
+        printf("Warning: unknown overload policy %s, using auto.\n", s.overload_policy.c_str());
+    governor_.configure(policy, s.decimate, s.latest_period, s.publish_latency_high,
+                        s.publish_latency_low);
+
+    if (s.baud != settings_.baud)
+    {
+        speed_t speed = serial_port::speed(s.baud);
+        if (speed == B0)
+            printf("Warning: unsupported baud rate %d.\n", s.baud);
+        else if (receiver_.set_baud(speed) < 0)
+            printf("Error: Failed to set %d baud - %s\n", s.baud, strerror(errno));
+    }
+
+    if (s.log_level != settings_.log_level)
+    {
+        ros::console::levels::Level level = ros::console::levels::Info;
+        if (s.log_level == "debug")
+            level = ros::console::levels::Debug;
+        else if (s.log_level == "warn")
+            level = ros::console::levels::Warn;
+        else if (s.log_level == "error")
+            level = ros::console::levels::Error;
+        if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, level))
+            ros::console::notifyLoggerLevelsChanged();
+    }
+
+    settings_ = s;
+    // the backend in use, which differs from the one asked for after a
+    // fallback to epoll
+    settings_.io_backend = io_backend;
+    settings_.sleep_ms = sleep_ms;
+    settings_.read_size = std::max(1, std::min(s.read_size, RFDF_READ_MAX));
+    settings_.max_batch = std::max(1, std::min(s.max_batch, RFDF_MAX_BATCH));
+}
+
+const geometry_msgs::Vector3Stamped::Ptr &
+rfdf::next_msg(msg_pool<geometry_msgs::Vector3Stamped, RFDF_MSG_POOL> &pool,
+               const rfdf_frame &frame, const std::string &frame_id)
+{
+    const geometry_msgs::Vector3Stamped::Ptr &msg = pool.next();
+    msg->header.seq = frame.id;
+    msg->header.stamp.fromSec(frame.stamp);
+    msg->header.frame_id = frame_id;
+    return msg;
+}
+
+void rfdf::ros_publish(const rfdf_frame &frame)
+{
+    const geometry_msgs::Vector3Stamped::Ptr &msg = next_msg(rfdf_msgs_, frame, frame_id_);
+    msg->vector.x = 0;
+    msg->vector.y = frame.elevation;
+    msg->vector.z = frame.azimuth;
+    rfdf_pub_.publish(msg);
+
+    // unit vector in the sensor frame, see bearing_to_vector()
+    if (direction_)
+    {
+        const geometry_msgs::Vector3Stamped::Ptr &dir = next_msg(direction_msgs_, frame, frame_id_);
+        bearing_to_vector(frame.elevation, frame.azimuth,
+                          &dir->vector.x, &dir->vector.y, &dir->vector.z);
+        direction_pub_.publish(dir);
+    }
+
+}
+
+// circular mean over the last smoothing_window frames on rfdf_smoothed and
+// the matching circular variance (1 - R) on rfdf_variance, using the same
+// field layout as rfdf. The filters see every frame; publish is false for
+// frames held back by the governor
+void rfdf::smooth_and_publish(const rfdf_frame &frame, bool publish)
+{
+    bool el_ok = el_filter_.update(frame.elevation);
+    bool az_ok = az_filter_.update(frame.azimuth);
+    if ((!el_ok && !az_ok) || !publish)
+        return;
+
+    const geometry_msgs::Vector3Stamped::Ptr &mean = next_msg(smoothed_msgs_, frame, frame_id_);
+    mean->vector.x = 0;
+    mean->vector.y = remainder(el_filter_.mean(), 360.0);
+    mean->vector.z = az_filter_.mean();
+    smoothed_pub_.publish(mean);
+
+    const geometry_msgs::Vector3Stamped::Ptr &var = next_msg(variance_msgs_, frame, frame_id_);
+    var->vector.x = 0;
+    var->vector.y = el_filter_.variance();
+    var->vector.z = az_filter_.variance();
+    variance_pub_.publish(var);
+}
+
+int rfdf::subscribers() const
+{
+    int n = rfdf_pub_.getNumSubscribers();
+    if (direction_)
+        n += direction_pub_.getNumSubscribers();
+    if (smoothing_)
+        n += smoothed_pub_.getNumSubscribers() + variance_pub_.getNumSubscribers();
+    if (!target_frame_.empty())
+        n += world_pub_.getNumSubscribers();
+    return n;
+}
+
+// every frame is logged and smoothed; which of them are published is up to
+// the governor, see publish_governor.h
+void rfdf::publish_batch(const rfdf_frame *frames, int n)
+{
+    // one datagram per batch, sent ahead of the ROS publishing
+    if (udp_.is_open() && n > 0)
+    {
+        for (int i = 0; i < n; i++)
+            udp_.add((int64_t)(frames[i].stamp * 1e9), frames[i].id, frames[i].azimuth,
+                     frames[i].elevation);
+        udp_.end_batch();
+        udp_.flush();
+    }
+
+    RFDF_TRACE(TRACE_PUBLISH_BEGIN, n, 0);
+    publish_policy before = governor_.policy();
+    bool publish = n > 0 && governor_.begin(subscribers(), rfdf_now());
+    int published = 0;
+    // the governor is fed the time spent in the publish calls alone; the
+    // fixed cost of logging, tracking and TF lookups would otherwise grow
+    // per frame as fewer frames are published, and keep it shedding
+    publish_time_ = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        bool admit = publish && governor_.admit(i, n);
+        if (admit)
+        {
+            double start = rfdf_now();
+            ros_publish(frames[i]);
+            publish_time_ += rfdf_now() - start;
+            selected_[published++] = frames[i];
+        }
+        if (smoothing_)
+            smooth_and_publish(frames[i], admit);
+        if (log_.is_open())
+        {
+            bearing_record r;
+            r.stamp = (int64_t)(frames[i].stamp * 1e9);
+            r.recv_stamp = (int64_t)(frames[i].recv_stamp * 1e9);
+            r.id = frames[i].id;
+            r.azimuth = frames[i].azimuth;
+            r.elevation = frames[i].elevation;
+            r.device = device_id_;
+            log_.log(r);
+        }
+        if (tracking_)
+            tracker_.update(frames[i].stamp, frames[i].azimuth, frames[i].elevation);
+    }
+    if (tracking_ && n > 0)
+        tracker_shm_.publish(tracker_.state());
+    if (!target_frame_.empty() && published > 0)
+        transform_batch(selected_, published);
+
+    governor_.published(published, publish_time_);
+    RFDF_TRACE(TRACE_PUBLISH_END, published, 0);
+    if (governor_.policy() != before)
+        ROS_WARN("Publish latency %.1f us per frame, switching from %s to %s publishing.",
+                 1e6 * governor_.latency(), publish_governor::name(before),
+                 publish_governor::name(governor_.policy()));
+}
+
+bool rfdf::lookup_rotation(const ros::Time &stamp, tf2::Quaternion &q)
+{
+    geometry_msgs::TransformStamped t;
+    try
+    {
+        t = tf_buffer_.lookupTransform(target_frame_, frame_id_, stamp);
+    }
+    catch (tf2::TransformException &ex)
+    {
+        // attitude not yet in the buffer for this stamp: use the newest,
+        // which is off by however far the attitude moved since
+        try
+        {
+            t = tf_buffer_.lookupTransform(target_frame_, frame_id_, ros::Time(0));
+        }
+        catch (tf2::TransformException &ex)
+        {
+            ROS_WARN_THROTTLE(1.0, "No transform from %s to %s: %s", frame_id_.c_str(),
+                              target_frame_.c_str(), ex.what());
+            return false;
+        }
+        tf_fallbacks_++;
+        ROS_WARN_THROTTLE(1.0, "No transform from %s to %s at %.3f, using the newest one "
+                          "(%llu times so far): %s", frame_id_.c_str(), target_frame_.c_str(),
+                          stamp.toSec(), (unsigned long long)tf_fallbacks_, ex.what());
+    }
+    const geometry_msgs::Quaternion &r = t.transform.rotation;
+    q = tf2::Quaternion(r.x, r.y, r.z, r.w);
+    return true;
+}
+
+// unit bearing vectors rotated into target_frame on rfdf_world. The buffer
+// is queried at the first and last frame of the batch only, two reads per
+// batch (one for a single frame); frames in between slerp between the two,
+// in a single pass
+void rfdf::transform_batch(const rfdf_frame *frames, int n)
+{
+    tf2::Quaternion q0, q1;
+    ros::Time t0, t1;
+    t0.fromSec(frames[0].stamp);
+    t1.fromSec(frames[n - 1].stamp);
+
+    if (!lookup_rotation(t0, q0))
+        return;
+    double span = frames[n - 1].stamp - frames[0].stamp;
+    if (span <= 0 || !lookup_rotation(t1, q1))
+    {
+        q1 = q0;
+        span = 0;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        double x, y, z;
+        bearing_to_vector(frames[i].elevation, frames[i].azimuth, &x, &y, &z);
+        tf2::Quaternion q = span > 0 ? q0.slerp(q1, (frames[i].stamp - frames[0].stamp) / span) : q0;
+        tf2::Vector3 d = tf2::quatRotate(q, tf2::Vector3(x, y, z));
+
+        const geometry_msgs::Vector3Stamped::Ptr &msg = next_msg(world_msgs_, frames[i], target_frame_);
+        msg->vector.x = d.x();
+        msg->vector.y = d.y();
+        msg->vector.z = d.z();
+        double start = rfdf_now();
+        world_pub_.publish(msg);
+        publish_time_ += rfdf_now() - start;
+    }
+}
+
+void rfdf::configure_serial()
+{
+    speed_t baud = serial_port::speed(settings_.baud);
+    if (receiver_.open(device.c_str(), baud != B0 ? baud : B115200) < 0)
+    {
+        printf("Error: Failed to open serial port - %s\n", strerror(errno));
+        printf("Waiting for %s to appear.\n", device.c_str());
+        wait_for_device();
+    }
+}
+
+// block until the device node is back, then reopen and reconfigure it
+bool rfdf::wait_for_device()
+{
+    while (ros::ok())
+    {
+        if (receiver_.reconnect(100) == 0)
+            return true;
+    }
+    return false;
+}
+
+// send serial data (used only by Gizmo)
+void rfdf::send_data_serial(float elevation, float azimuth, int id)
+{
+    // create serial message
+    char msg[BUF_SIZE];
+    int len = rfdf_encode(msg, BUF_SIZE, elevation, azimuth, id, receiver_.parser_.require_checksum_);
+
+    // transmit message
+    receiver_.io_->write(msg, len);
+    receiver_.io_->flush();
+}
+
+// read serial data main loop
+void rfdf::main_loop()
+{
+    char buf[RFDF_READ_MAX];
+    int cr;
+    ros::Time stamp;
+
+    configure_serial();
+
+    while (ros::ok())
+    {
+        if (settings_changed_.load(std::memory_order_acquire))
+        {
+            rfdf_settings s;
+            {
+                std::lock_guard<std::mutex> lock(settings_mutex_);
+                s = pending_settings_;
+                settings_changed_.store(false, std::memory_order_relaxed);
+            }
+            apply_settings(s);
+        }
+
+        // wait for and read from serial port
+        RFDF_TRACE(TRACE_READ_ENTER, 0, 0);
+        cr = receiver_.io_->read(buf, settings_.read_size, 100);
+        RFDF_TRACE(TRACE_READ_EXIT, cr, 0);
+        stamp = ros::Time::now();
+        // process input from serial data
+        if (cr > 0)
+            process_serial_data(buf, cr, stamp);
+        // device unplugged or reset: wait for it instead of exiting
+        if (cr < 0)
+        {
+            printf("Error: Lost serial port %s - %s\n", device.c_str(), strerror(errno));
+            receiver_.lost();
+            if (!wait_for_device())
+                break;
+            printf("Reconnected %s after %.3f s (%lu outages).\n", device.c_str(),
+                   receiver_.last_outage(), (unsigned long)receiver_.stats().outages);
+            continue;
+        }
+    }
+}
+
+void rfdf::process_serial_data(char *buf, int cr, const ros::Time &stamp)
+{
+    batch_len_ = 0;
+    receiver_.decode(buf, cr, stamp.toSec(), [this](const rfdf_frame &frame)
+    {
+        // found a message
+        if (settings_.echo_frames)
+            std::cout << "EAI " << frame.elevation << "," << frame.azimuth << "," << frame.id << '\n';
+        batch_[batch_len_++] = frame;
+        if (batch_len_ >= settings_.max_batch)
+        {
+            publish_batch(batch_, batch_len_);
+            batch_len_ = 0;
+        }
+    });
+    publish_batch(batch_, batch_len_);
+}
+
+
+// ~tx_frames test frames at ~tx_rate Hz on absolute deadlines (0 for as
+// fast as the link allows); ~tx_policy "skip" or "catch_up" decides what
+// happens to deadlines missed while sending
+void rfdf::test_transmit_loop()
+{
+    ros::NodeHandle pnh("~");
+    double rate;
+    int frames;
+    std::string policy;
+    pnh.param("tx_rate", rate, 100.0);
+    pnh.param("tx_frames", frames, 100);
+    pnh.param<std::string>("tx_policy", policy, "skip");
+
+    configure_serial();
+
+    tx_scheduler sched;
+    if (sched.start(rate, policy == "catch_up" ? TX_CATCH_UP : TX_SKIP) < 0)
+    {
+        printf("Error: Failed to start transmit timer - %s\n", strerror(errno));
+        return;
+    }
+    for (int i = 0; i < frames && ros::ok(); )
+    {
+        for (int n = sched.wait(); n > 0 && i < frames; n--, i++)
+        {
+            double elevation = i % 180 - 90 + 0.1;
+            double azimuth = (100 - i) % 360 + 0.2;
+            // transmit one message
+            send_data_serial(elevation, azimuth, i);
+            sched.sent();
+        }
+    }
+    printf("Sent %llu frames, %llu deadlines skipped, %llu overruns.\n",
+           (unsigned long long)sched.frames_, (unsigned long long)sched.skipped_,
+           (unsigned long long)sched.overruns_);
+    printf("Send jitter: mean %.1f us, rms %.1f us, max %.1f us.\n", 1e6 * sched.mean_jitter(),
+           1e6 * sched.rms_jitter(), 1e6 * sched.max_jitter());
+}
+
+void rfdf::parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+        {"device", required_argument,            0, 'd'},
+        {"test",   no_argument,       &run_test_flag, 1},
+        {"help",   no_argument,                  0, 'h'}
+    };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "d:th", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 0:
+            break;
+        case 'd':
+            device_flag = 1;
+            device = optarg;
+            break;
+        case 't':
+            run_test_flag = 1;
+            break;
+        case 'h':
+            //print_usage();
+            exit(EXIT_SUCCESS);
+            break;
+        case '?':
+            printf("Error: Invalid option.\n");
+            //print_usage();
+            exit(EXIT_FAILURE);
+        default:
+            printf("Error: Invalid option %c.\n", c);
+            //print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+// --------------------------------------------------------
+// main: entrance point for the program
+
+int main(int argc, char** argv)
+{
+
+    ros::init(argc, argv, "rfdf_node");
+    rfdf class_obj;
+
+    // process input arguments
+//    class_obj.parse_options(argc, argv);
+//    class_obj.run_test_flag = 1;
+    class_obj.device_flag = 1;
+    // prefer a stable /dev/serial/by-id/... path so a reset adapter is
+    // found again even if it enumerates under a different ttyUSB number
+    ros::NodeHandle("~").param<std::string>("device", class_obj.device, "/dev/ttyUSB1");
+
+
+    if (!class_obj.device_flag)
+    {
+        std::cout << "Device option required." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // run test loop
+    if (class_obj.run_test_flag)
+    {
+        class_obj.test_transmit_loop();
+    }
+
+    // run main loop
+    if (!class_obj.run_test_flag)
+    {
+        class_obj.main_loop();
+    }
+    rfdf_trace_stop();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,379 @@
+/**********************************************************
+rfdf_analyze.cpp
+
+Description:
+  Post-mission analysis of bearing logs and raw serial
+  captures, spread across all cores
+
+*/
+const char *use_msg =
+"Usage:\n"
+"  rfdf_analyze [OPTIONS] FILE...\n\n"
+
+"  Each FILE is either a bearing log written by rfdf_node\n"
+"  (~log_file) or a raw capture of the serial stream, which\n"
+"  is decoded with the same framer and parser as the node.\n\n"
+
+"  -j, --jobs=N\n"
+"    number of worker threads (default: one per core)\n"
+"  -h, --help\n"
+"    print this usage message\n";
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bearing_log.h"
+#include "rfdf_parser.h"
+
+#define RAD2DEG (180.0 / M_PI)
+#define DEG2RAD (M_PI / 180.0)
+
+// log blocks handed to a worker at a time
+#define ANALYZE_BLOCKS_PER_ITEM 32
+// latency histogram: 10 us bins up to 100 ms, plus an overflow bin
+#define ANALYZE_LATENCY_BIN 1e-5
+#define ANALYZE_LATENCY_BINS 10000
+// forward id jumps larger than this are counter resets, not losses
+#define ANALYZE_MAX_GAP 100000
+
+
+static int jobs = 0;
+
+// one unit of work: a range of blocks of a log, or a whole raw capture
+struct work_item
+{
+    int file;
+    bool is_log;
+    size_t block_begin, block_end;
+
+    // ids at the edges of the item, to count losses across item borders
+    bool have_ids;
+    int32_t first_id, last_id;
+};
+
+// per thread partial results, merged once all workers are done
+struct aggregate
+{
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    uint64_t parse_errors = 0;
+    uint64_t unknown = 0;
+    uint64_t checksum_errors = 0;
+    uint64_t lost = 0;
+    uint64_t resets = 0;
+    double sum_sin_az = 0, sum_cos_az = 0;
+    double sum_el = 0, sum_el2 = 0;
+    uint64_t latency_count = 0;
+    uint64_t latency_hist[ANALYZE_LATENCY_BINS + 1] = {0};
+
+    void add_id(work_item &item, int32_t id)
+    {
+        if (item.have_ids)
+            count_gap(item.last_id, id);
+        else
+            item.first_id = id;
+        item.have_ids = true;
+        item.last_id = id;
+    }
+
+    void count_gap(int32_t prev, int32_t id)
+    {
+        int64_t gap = (int64_t)id - prev;
+        if (gap > 1 && gap <= ANALYZE_MAX_GAP)
+            lost += gap - 1;
+        else if (gap <= 0 || gap > ANALYZE_MAX_GAP)
+            resets++;
+    }
+
+    void add_bearing(float azimuth, float elevation)
+    {
+        frames++;
+        sum_sin_az += sin(azimuth * DEG2RAD);
+        sum_cos_az += cos(azimuth * DEG2RAD);
+        sum_el += elevation;
+        sum_el2 += (double)elevation * elevation;
+    }
+
+    void add_latency(double latency)
+    {
+        long bin = lrint(latency / ANALYZE_LATENCY_BIN);
+        if (bin < 0)
+            bin = 0;
+        if (bin > ANALYZE_LATENCY_BINS)
+            bin = ANALYZE_LATENCY_BINS;
+        latency_hist[bin]++;
+        latency_count++;
+    }
+
+    void merge(const aggregate &o)
+    {
+        bytes += o.bytes;
+        frames += o.frames;
+        parse_errors += o.parse_errors;
+        unknown += o.unknown;
+        checksum_errors += o.checksum_errors;
+        lost += o.lost;
+        resets += o.resets;
+        sum_sin_az += o.sum_sin_az;
+        sum_cos_az += o.sum_cos_az;
+        sum_el += o.sum_el;
+        sum_el2 += o.sum_el2;
+        latency_count += o.latency_count;
+        for (int i = 0; i <= ANALYZE_LATENCY_BINS; i++)
+            latency_hist[i] += o.latency_hist[i];
+    }
+
+    double latency_quantile(double q) const
+    {
+        uint64_t target = (uint64_t)ceil(q * latency_count);
+        uint64_t seen = 0;
+        for (int i = 0; i <= ANALYZE_LATENCY_BINS; i++)
+        {
+            seen += latency_hist[i];
+            if (seen >= target && seen > 0)
+                return i * ANALYZE_LATENCY_BIN;
+        }
+        return ANALYZE_LATENCY_BINS * ANALYZE_LATENCY_BIN;
+    }
+};
+
+static double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void print_usage()
+{
+    printf("%s", use_msg);
+}
+
+
+// --------------------------------------------------------
+// Workers
+
+// the reader is shared by all items of the log; read_block only reads the
+// mapping
+void analyze_log(const bearing_log_reader &log, work_item &item, aggregate &agg)
+{
+    std::vector<bearing_record> records;
+
+    for (size_t b = item.block_begin; b < item.block_end && b < log.blocks(); b++)
+    {
+        if (log.read_block(b, records) < 0)
+        {
+            agg.parse_errors++;
+            continue;
+        }
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const bearing_record &r = records[i];
+            agg.add_id(item, r.id);
+            agg.add_bearing(r.azimuth, r.elevation);
+            agg.add_latency(1e-9 * (r.recv_stamp - r.stamp));
+        }
+    }
+}
+
+void analyze_capture(const char *path, work_item &item, aggregate &agg)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    rfdf_parser parser;
+    parser.feed((const char *)map, st.st_size, 0, [&](const rfdf_frame &frame)
+    {
+        agg.add_id(item, frame.id);
+        agg.add_bearing(frame.azimuth, frame.elevation);
+    });
+    agg.bytes += st.st_size;
+    agg.parse_errors += parser.stats_.parse_errors + parser.stats_.overflows;
+    agg.unknown += parser.stats_.unknown;
+    agg.checksum_errors += parser.stats_.checksum_errors;
+    munmap(map, st.st_size);
+}
+
+void worker(const std::vector<std::string> &files, const std::vector<bearing_log_reader *> &logs,
+            std::vector<work_item> &items, std::atomic<size_t> &next, aggregate &agg)
+{
+    size_t i;
+    while ((i = next++) < items.size())
+    {
+        work_item &item = items[i];
+        if (item.is_log)
+            analyze_log(*logs[item.file], item, agg);
+        else
+            analyze_capture(files[item.file].c_str(), item, agg);
+    }
+}
+
+// split the inputs into items: logs by block range, captures whole. Each
+// log is opened once here, into logs, and stays mapped for the workers
+void plan_work(const std::vector<std::string> &files, std::vector<bearing_log_reader *> &logs,
+               std::vector<work_item> &items)
+{
+    logs.assign(files.size(), nullptr);
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        work_item item;
+        memset(&item, 0, sizeof(item));
+        item.file = f;
+        if (access(files[f].c_str(), R_OK) < 0)
+        {
+            fprintf(stderr, "Error: Cannot read %s - %s\n", files[f].c_str(), strerror(errno));
+            continue;
+        }
+
+        bearing_log_reader *log = new bearing_log_reader();
+        if (log->open(files[f].c_str()) < 0)
+        {
+            delete log;
+            item.is_log = false;
+            items.push_back(item);
+            continue;
+        }
+        logs[f] = log;
+        item.is_log = true;
+        for (size_t b = 0; b < log->blocks(); b += ANALYZE_BLOCKS_PER_ITEM)
+        {
+            item.block_begin = b;
+            item.block_end = std::min(b + ANALYZE_BLOCKS_PER_ITEM, log->blocks());
+            items.push_back(item);
+        }
+    }
+}
+
+void parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+            {"jobs", required_argument, 0, 'j'},
+            {"help", no_argument,       0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "j:h", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'h':
+            print_usage();
+            exit(EXIT_SUCCESS);
+        default:
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+// --------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+    if (optind >= argc)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    if (jobs < 1)
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> files(argv + optind, argv + argc);
+    std::vector<bearing_log_reader *> logs;
+    std::vector<work_item> items;
+    double start = wall_time();
+    plan_work(files, logs, items);
+
+    // partial aggregates are large, keep them off the stack
+    std::vector<aggregate> partial(jobs);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next(0);
+    for (int i = 0; i < jobs; i++)
+        threads.push_back(std::thread(worker, std::cref(files), std::cref(logs), std::ref(items),
+                                      std::ref(next), std::ref(partial[i])));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    aggregate *total = new aggregate();
+    for (int i = 0; i < jobs; i++)
+        total->merge(partial[i]);
+    // bytes read are file bytes, for logs as for captures
+    for (size_t f = 0; f < logs.size(); f++)
+    {
+        if (logs[f])
+            total->bytes += logs[f]->size();
+        delete logs[f];
+    }
+    // losses across the borders of consecutive items of the same log
+    for (size_t i = 1; i < items.size(); i++)
+        if (items[i].file == items[i - 1].file && items[i].have_ids && items[i - 1].have_ids)
+            total->count_gap(items[i - 1].last_id, items[i].first_id);
+    double elapsed = wall_time() - start;
+
+    const aggregate &a = *total;
+    double n = a.frames > 0 ? (double)a.frames : 1.0;
+    double az = atan2(a.sum_sin_az, a.sum_cos_az) * RAD2DEG;
+    double r = sqrt(a.sum_sin_az * a.sum_sin_az + a.sum_cos_az * a.sum_cos_az) / n;
+    double el_var = a.sum_el2 / n - (a.sum_el / n) * (a.sum_el / n);
+
+    printf("files:        %zu (%zu work items, %d threads)\n", files.size(), items.size(), jobs);
+    printf("frames:       %llu\n", (unsigned long long)a.frames);
+    printf("parse errors: %llu\n", (unsigned long long)a.parse_errors);
+    printf("other lines:  %llu (SIG, CHN, HLT and unknown headers)\n", (unsigned long long)a.unknown);
+    printf("bad checksum: %llu\n", (unsigned long long)a.checksum_errors);
+    printf("lost:         %llu (%.3f %%), %llu counter resets\n", (unsigned long long)a.lost,
+           100.0 * a.lost / (a.lost + n), (unsigned long long)a.resets);
+    printf("azimuth:      mean %.2f deg, circular variance %.4f\n", az < 0 ? az + 360 : az, 1 - r);
+    printf("elevation:    mean %.2f deg, std %.2f deg\n", a.sum_el / n, sqrt(el_var > 0 ? el_var : 0));
+    if (a.latency_count > 0)
+        printf("latency:      p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms\n",
+               1e3 * a.latency_quantile(0.5), 1e3 * a.latency_quantile(0.9),
+               1e3 * a.latency_quantile(0.99), 1e3 * a.latency_quantile(0.999));
+    printf("throughput:   %.3f s, %.1f MB/s, %.0f frames/s\n", elapsed,
+           a.bytes / elapsed / 1e6, a.frames / elapsed);
+
+    delete total;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+/**********************************************************
+rfdf_bench.cpp
+
+Description:
+  Compares the serial I/O backends on a pseudo terminal
+  pair: system calls per frame and receive latency
+
+*/
+const char *use_msg =
+"Usage:\n"
+"  rfdf_bench [OPTIONS]\n\n"
+
+"  A transmitter thread writes EAI frames into the master side\n"
+"  of a pty while the backend under test reads the slave side,\n"
+"  the same way rfdf_node reads the receiver.\n\n"
+
+"  -b, --backends=LIST\n"
+"    comma separated backends to run (default: sleep,epoll,hybrid,uring)\n"
+"  -n, --frames=N\n"
+"    frames sent per backend (default: 2000)\n"
+"  -r, --rate=HZ\n"
+"    frame bursts per second (default: 500)\n"
+"  -B, --burst=N\n"
+"    frames written per flush (default: 1)\n"
+"  -s, --spin=US\n"
+"    spin window bound of the hybrid backend (default: 200)\n"
+"  -a, --alloc-check\n"
+"    count heap allocations on the reading thread once the first\n"
+"    tenth of the frames is through and fail if there are any;\n"
+"    covers the decode path (read, framing, parsing, clock sync,\n"
+"    smoothing) only, not publishing\n"
+"  -t, --trace=FILE\n"
+"    record the tracepoints into FILE for scripts/rfdf_trace.py\n"
+"    (needs a build with -DRFDF_TRACE=ON)\n"
+"  -h, --help\n"
+"    print this usage message\n";
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rfdf_core.h"
+#include "rfdf_io.h"
+#include "rfdf_parser.h"
+#include "circular_filter.h"
+#include "tx_scheduler.h"
+#include "rfdf_trace.h"
+
+static std::string backends = "sleep,epoll,hybrid,uring";
+static int frames = 2000;
+static double rate = 500;
+static int burst = 1;
+static int spin_us = RFDF_IO_SPIN_US;
+static int alloc_check = 0;
+static const char *trace_file = NULL;
+
+struct bench_result
+{
+    std::string name;
+    int received;
+    double rx_syscalls, tx_syscalls;
+    double p50, p99, max;
+    double tx_jitter;
+    uint64_t allocs;
+};
+
+
+// --------------------------------------------------------
+// Allocation counting: glibc lets a program replace malloc as long as the
+// whole family is replaced, the originals stay reachable as __libc_*.
+// Only the decode path runs here; the ROS side (msg_pool, TF lookups,
+// roscpp's own serialization buffers) is outside what -a checks
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t align, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static thread_local bool counting = false;
+static thread_local uint64_t allocs = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    if (counting)
+        allocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    if (counting)
+        allocs++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t align, size_t size)
+{
+    if (counting)
+        allocs++;
+    return __libc_memalign(align, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t align, size_t size)
+{
+    *ptr = memalign(align, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+extern "C" void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+extern "C" void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+void print_usage()
+{
+    printf("%s", use_msg);
+}
+
+// open a raw pty pair; the slave side is what the backend reads
+static int open_pty(int &master, int &slave)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+        return -1;
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (slave < 0)
+        return -1;
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    return 0;
+}
+
+static void transmit(rfdf_io *tx, std::atomic<double> *sent, tx_scheduler *sched)
+{
+    char msg[RFDF_LINE_SIZE];
+    int n;
+
+    sched->start(rate, TX_CATCH_UP);
+    for (int id = 0; id < frames && (n = sched->wait()) > 0; )
+    {
+        for (; n > 0 && id < frames; n--)
+        {
+            for (int i = 0; i < burst && id < frames; i++, id++)
+            {
+                int len = rfdf_encode(msg, sizeof(msg), id % 360, (id * 7) % 360, id);
+                sent[id].store(rfdf_now(), std::memory_order_release);
+                tx->write(msg, len);
+            }
+            tx->flush();
+            sched->sent();
+        }
+    }
+}
+
+static int run_backend(const std::string &name, bench_result &res)
+{
+    int master, slave;
+    if (open_pty(master, slave) < 0)
+    {
+        fprintf(stderr, "Error: Cannot open pty - %s\n", strerror(errno));
+        return -1;
+    }
+
+    std::unique_ptr<rfdf_io> rx(rfdf_io::create(name.c_str(), spin_us));
+    std::unique_ptr<rfdf_io> tx(rfdf_io::create(name.c_str()));
+    rx->attach(slave);
+    tx->attach(master);
+    res.name = rx->name();
+
+    std::unique_ptr<std::atomic<double>[]> sent(new std::atomic<double>[frames]);
+    std::vector<double> latency;
+    latency.reserve(frames);
+    // the node's path: framing, parsing, clock sync and smoothing
+    rfdf_receiver receiver;
+    circular_filter el_filter, az_filter;
+    el_filter.configure(10, 0);
+    az_filter.configure(10, 0);
+    char buf[256];
+    allocs = 0;
+
+    tx_scheduler sched;
+    std::thread thread(transmit, tx.get(), sent.get(), &sched);
+    double deadline = rfdf_now() + frames / rate / std::max(burst, 1) + 2.0;
+    while ((int)latency.size() < frames && rfdf_now() < deadline)
+    {
+        RFDF_TRACE(TRACE_READ_ENTER, 0, 0);
+        ssize_t cr = rx->read(buf, sizeof(buf), 100);
+        RFDF_TRACE(TRACE_READ_EXIT, cr, 0);
+        if (cr < 0)
+            break;
+        double now = rfdf_now();
+        receiver.decode(buf, cr, now, [&](const rfdf_frame &frame)
+        {
+            el_filter.update(frame.elevation);
+            az_filter.update(frame.azimuth);
+            if (frame.id >= 0 && frame.id < frames)
+                latency.push_back(now - sent[frame.id].load(std::memory_order_acquire));
+        });
+        // steady state once the first tenth of the frames is through
+        if (alloc_check && (int)latency.size() >= frames / 10)
+            counting = true;
+    }
+    counting = false;
+    thread.join();
+    res.allocs = allocs;
+    res.tx_jitter = sched.rms_jitter();
+
+    res.received = latency.size();
+    res.rx_syscalls = (double)rx->syscalls_ / std::max(res.received, 1);
+    res.tx_syscalls = (double)tx->syscalls_ / frames;
+    std::sort(latency.begin(), latency.end());
+    if (latency.empty())
+        latency.push_back(NAN);
+    res.p50 = latency[latency.size() / 2];
+    res.p99 = latency[(latency.size() * 99) / 100];
+    res.max = latency.back();
+
+    rx->detach();
+    tx->detach();
+    close(slave);
+    close(master);
+    return 0;
+}
+
+void parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+            {"backends", required_argument, 0, 'b'},
+            {"frames",   required_argument, 0, 'n'},
+            {"rate",     required_argument, 0, 'r'},
+            {"burst",    required_argument, 0, 'B'},
+            {"spin",     required_argument, 0, 's'},
+            {"alloc-check", no_argument,    0, 'a'},
+            {"trace",    required_argument, 0, 't'},
+            {"help",     no_argument,       0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "b:n:r:B:s:at:h", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'b':
+            backends = optarg;
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'B':
+            burst = atoi(optarg);
+            break;
+        case 's':
+            spin_us = atoi(optarg);
+            break;
+        case 'a':
+            alloc_check = 1;
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'h':
+            print_usage();
+            exit(EXIT_SUCCESS);
+        default:
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (frames < 1 || rate <= 0 || burst < 1)
+    {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+// --------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+
+    if (trace_file)
+    {
+#ifdef RFDF_TRACE_ENABLED
+        rfdf_trace_start(trace_file);
+#else
+        fprintf(stderr, "Error: Tracing was not built in, configure with -DRFDF_TRACE=ON.\n");
+        return EXIT_FAILURE;
+#endif
+    }
+
+    printf("%d frames at %.0f Hz, %d per write burst\n\n", frames, rate, burst);
+    printf("%-8s %9s %12s %12s %10s %10s %10s %12s\n", "backend", "received",
+           "rx sys/frame", "tx sys/frame", "p50 ms", "p99 ms", "max ms", "tx jitter us");
+
+    int status = EXIT_SUCCESS;
+    size_t pos = 0;
+    while (pos <= backends.size())
+    {
+        size_t end = backends.find(',', pos);
+        if (end == std::string::npos)
+            end = backends.size();
+        std::string name = backends.substr(pos, end - pos);
+        pos = end + 1;
+        if (name.empty())
+            continue;
+
+        bench_result res;
+        if (run_backend(name, res) < 0)
+            return EXIT_FAILURE;
+        printf("%-8s %9d %12.2f %12.2f %10.3f %10.3f %10.3f %12.1f\n", res.name.c_str(),
+               res.received, res.rx_syscalls, res.tx_syscalls, 1e3 * res.p50, 1e3 * res.p99,
+               1e3 * res.max, 1e6 * res.tx_jitter);
+        if (alloc_check && res.allocs > 0)
+        {
+            printf("Error: %s made %llu steady state allocations.\n", res.name.c_str(),
+                   (unsigned long long)res.allocs);
+            status = EXIT_FAILURE;
+        }
+    }
+    if (trace_file && rfdf_trace_stop() < 0)
+    {
+        fprintf(stderr, "Error: Cannot write %s - %s\n", trace_file, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    return status;
+}
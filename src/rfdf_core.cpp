@@ -0,0 +1,102 @@
+/**********************************************************
+rfdf_core.cpp
+
+Description:
+  ROS independent pieces of the rfdf receiver
+
+*/
+
+#include "rfdf_core.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+
+double rfdf_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+int rfdf_receiver::open(const char *device, speed_t baud)
+{
+    if (device != device_)
+    {
+        strncpy(device_, device, sizeof(device_) - 1);
+        device_[sizeof(device_) - 1] = '\0';
+    }
+    baud_ = baud;
+    if (port_.open(device_, baud_) < 0)
+    {
+        int err = errno;
+        watch_.watch(device_);
+        watch_.backoff();
+        errno = err;
+        return -1;
+    }
+    attach_io();
+    return 0;
+}
+
+void rfdf_receiver::set_io(const char *mode, int spin_us, int sleep_us)
+{
+    if (io_)
+        io_->flush();
+    delete io_;
+    io_ = rfdf_io::create(mode, spin_us, sleep_us);
+    if (port_.is_open())
+        attach_io();
+}
+
+// hand the open port to the backend; one that cannot take it (io_uring
+// refused by a seccomp filter or the memlock limit) is replaced by epoll
+void rfdf_receiver::attach_io()
+{
+    if (!io_ || io_->attach(port_.fd()) == 0)
+        return;
+    printf("Warning: %s I/O failed to attach - %s, using epoll.\n", io_->name(), strerror(errno));
+    delete io_;
+    io_ = rfdf_io::create("epoll");
+    if (io_->attach(port_.fd()) < 0)
+        printf("Error: epoll I/O failed to attach - %s\n", strerror(errno));
+}
+
+int rfdf_receiver::set_baud(speed_t baud)
+{
+    baud_ = baud;
+    if (!port_.is_open())
+        return 0;
+    return port_.configure(baud);
+}
+
+void rfdf_receiver::lost()
+{
+    if (io_)
+        io_->detach();
+    close();
+    parser_.stats_.outages++;
+    lost_stamp_ = rfdf_now();
+    watch_.watch(device_);
+}
+
+int rfdf_receiver::reconnect(int timeout_ms)
+{
+    if (watch_.wait(timeout_ms) <= 0)
+        return -1;
+    // the node can exist before udev applies its permissions; the watch
+    // stays armed and reports the attribute change
+    if (port_.open(device_, baud_) < 0)
+    {
+        watch_.backoff();
+        return -1;
+    }
+    attach_io();
+    watch_.close();
+    if (lost_stamp_ > 0)
+        last_outage_ = rfdf_now() - lost_stamp_;
+    lost_stamp_ = 0;
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**********************************************************
+rfdf_fusion.cpp
+
+Description:
+  Real time emitter position from the bearings of
+  several RFDF arrays
+
+*/
+
+#include "rfdf_fusion.h"
+#include "bearing_tf.h"
+
+#define DEG2RAD (M_PI / 180.0)
+
+
+rfdf_fusion::rfdf_fusion()
+    : tf_listener_(tf_buffer_)
+{
+    ros::NodeHandle pnh("~");
+    vector<string> topics;
+    double forgetting, bearing_sigma, prior_sigma;
+
+    if (!pnh.getParam("bearing_topics", topics))
+        topics.push_back("rfdf_direction");
+    pnh.param<string>("world_frame", world_frame_, "map");
+    pnh.param("max_age", max_age_, 0.5);
+    double tf_timeout;
+    // how long a bearing waits for the pose of its array at its own stamp
+    pnh.param("tf_timeout", tf_timeout, 0.05);
+    tf_timeout_ = ros::Duration(tf_timeout);
+    pnh.param("min_arrays", min_arrays_, 2);
+    pnh.param("forgetting", forgetting, 0.99);
+    pnh.param("bearing_sigma", bearing_sigma, 2.0);
+    pnh.param("prior_sigma", prior_sigma, 1000.0);
+    fusion_ = bearing_fusion(forgetting, bearing_sigma * DEG2RAD, prior_sigma);
+
+    fix_pub_ = nh_.advertise<geometry_msgs::PointStamped>("rfdf_fix", 1);
+    for (size_t i = 0; i < topics.size(); i++)
+        bearing_subs_.push_back(nh_.subscribe(topics[i], 10, &rfdf_fusion::bearing_callback, this));
+}
+
+// fold every bearing in as it arrives and publish a fix at the same rate
+// once enough arrays have reported within max_age of each other
+void rfdf_fusion::bearing_callback(const geometry_msgs::Vector3Stamped::ConstPtr &msg)
+{
+    const ros::Time &stamp = msg->header.stamp;
+    if (stamp > newest_)
+        newest_ = stamp;
+    // too old to be time aligned with the other arrays
+    if ((newest_ - stamp).toSec() > max_age_)
+        return;
+
+    double origin[3], dir[3];
+    bool latest;
+    string error;
+    if (!bearing_in_frame(tf_buffer_, world_frame_, *msg, tf_timeout_, origin, dir, latest, error))
+    {
+        tf_drops_++;
+        ROS_WARN_THROTTLE(1.0, "No transform from %s to %s, bearing dropped (%llu so far): %s",
+                          msg->header.frame_id.c_str(), world_frame_.c_str(),
+                          (unsigned long long)tf_drops_, error.c_str());
+        return;
+    }
+    if (latest)
+    {
+        tf_fallbacks_++;
+        ROS_WARN_THROTTLE(1.0, "No transform from %s to %s at %.3f, using the newest one "
+                          "(%llu times so far): %s", msg->header.frame_id.c_str(),
+                          world_frame_.c_str(), msg->header.stamp.toSec(),
+                          (unsigned long long)tf_fallbacks_, error.c_str());
+    }
+    fusion_.add(origin, dir);
+    last_bearing_[msg->header.frame_id] = stamp;
+
+    int arrays = 0;
+    for (map<string, ros::Time>::const_iterator it = last_bearing_.begin(); it != last_bearing_.end(); ++it)
+        if ((newest_ - it->second).toSec() <= max_age_)
+            arrays++;
+    if (arrays < min_arrays_)
+        return;
+
+    const double *p = fusion_.position();
+    geometry_msgs::PointStamped fix;
+    fix.header.stamp = stamp;
+    fix.header.frame_id = world_frame_;
+    fix.point.x = p[0];
+    fix.point.y = p[1];
+    fix.point.z = p[2];
+    fix_pub_.publish(fix);
+}
+
+
+// --------------------------------------------------------
+// main: entrance point for the program
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "rfdf_fusion_node");
+    rfdf_fusion fusion;
+    ros::spin();
+    return EXIT_SUCCESS;
+}
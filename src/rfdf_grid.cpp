@@ -0,0 +1,122 @@
+/**********************************************************
+rfdf_grid.cpp
+
+Description:
+  Emitter likelihood heatmap built from the bearings
+  of one or more RFDF arrays
+
+*/
+
+#include "rfdf_grid.h"
+#include "bearing_tf.h"
+
+#define DEG2RAD (M_PI / 180.0)
+
+
+rfdf_grid::rfdf_grid()
+    : tf_listener_(tf_buffer_)
+{
+    ros::NodeHandle pnh("~");
+    vector<string> topics;
+    int width, height, max_cells;
+    double resolution, origin_x, origin_y, half_life, wedge_sigma, max_range, rate;
+
+    if (!pnh.getParam("bearing_topics", topics))
+        topics.push_back("rfdf_direction");
+    pnh.param<string>("world_frame", world_frame_, "map");
+    double tf_timeout;
+    // how long a bearing waits for the pose of its array at its own stamp
+    pnh.param("tf_timeout", tf_timeout, 0.05);
+    tf_timeout_ = ros::Duration(tf_timeout);
+    pnh.param("width", width, 1000);
+    pnh.param("height", height, 1000);
+    pnh.param("resolution", resolution, 10.0);
+    pnh.param("half_life", half_life, 60.0);
+    pnh.param("wedge_sigma", wedge_sigma, 3.0);
+    pnh.param("max_range", max_range, 5000.0);
+    pnh.param("publish_rate", rate, 1.0);
+    // memory budget: the grid and the published copy are both this size
+    pnh.param("max_cells", max_cells, 4 * 1024 * 1024);
+
+    if ((long)width * height > max_cells)
+    {
+        ROS_ERROR("Grid of %dx%d cells exceeds max_cells (%d), shrinking it.", width, height, max_cells);
+        double shrink = sqrt((double)max_cells / ((double)width * height));
+        width = std::max(1, (int)(width * shrink));
+        height = std::max(1, (int)(height * shrink));
+    }
+    // centred on the world origin by default, at the final size
+    pnh.param("origin_x", origin_x, -0.5 * width * resolution);
+    pnh.param("origin_y", origin_y, -0.5 * height * resolution);
+
+    grid_ = new bearing_grid(width, height, resolution, origin_x, origin_y,
+                             half_life, wedge_sigma * DEG2RAD, max_range);
+
+    msg_.header.frame_id = world_frame_;
+    msg_.info.resolution = resolution;
+    msg_.info.width = grid_->width();
+    msg_.info.height = grid_->height();
+    msg_.info.origin.position.x = origin_x;
+    msg_.info.origin.position.y = origin_y;
+    msg_.info.origin.orientation.w = 1.0;
+    msg_.data.resize((size_t)grid_->width() * grid_->height());
+
+    grid_pub_ = nh_.advertise<nav_msgs::OccupancyGrid>("rfdf_grid", 1);
+    for (size_t i = 0; i < topics.size(); i++)
+        bearing_subs_.push_back(nh_.subscribe(topics[i], 100, &rfdf_grid::bearing_callback, this));
+    publish_timer_ = nh_.createTimer(ros::Duration(1.0 / rate), &rfdf_grid::publish_callback, this);
+}
+
+void rfdf_grid::bearing_callback(const geometry_msgs::Vector3Stamped::ConstPtr &msg)
+{
+    double origin[3], dir[3];
+    bool latest;
+    string error;
+    if (!bearing_in_frame(tf_buffer_, world_frame_, *msg, tf_timeout_, origin, dir, latest, error))
+    {
+        tf_drops_++;
+        ROS_WARN_THROTTLE(1.0, "No transform from %s to %s, bearing dropped (%llu so far): %s",
+                          msg->header.frame_id.c_str(), world_frame_.c_str(),
+                          (unsigned long long)tf_drops_, error.c_str());
+        return;
+    }
+    if (latest)
+    {
+        tf_fallbacks_++;
+        ROS_WARN_THROTTLE(1.0, "No transform from %s to %s at %.3f, using the newest one "
+                          "(%llu times so far): %s", msg->header.frame_id.c_str(),
+                          world_frame_.c_str(), msg->header.stamp.toSec(),
+                          (unsigned long long)tf_fallbacks_, error.c_str());
+    }
+
+    // project onto the ground plane; near vertical bearings carry no
+    // horizontal information
+    double len = hypot(dir[0], dir[1]);
+    if (len < 1e-3)
+        return;
+    grid_->add(origin[0], origin[1], dir[0] / len, dir[1] / len, msg->header.stamp.toSec());
+    if (msg->header.stamp > newest_)
+        newest_ = msg->header.stamp;
+}
+
+void rfdf_grid::publish_callback(const ros::TimerEvent &event)
+{
+    if (grid_pub_.getNumSubscribers() == 0)
+        return;
+    grid_->snapshot(newest_.toSec(), msg_.data.data());
+    msg_.header.stamp = newest_;
+    msg_.info.map_load_time = newest_;
+    grid_pub_.publish(msg_);
+}
+
+
+// --------------------------------------------------------
+// main: entrance point for the program
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "rfdf_grid_node");
+    rfdf_grid grid;
+    ros::spin();
+    return EXIT_SUCCESS;
+}
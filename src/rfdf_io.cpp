@@ -0,0 +1,265 @@
+/**********************************************************
+rfdf_io.cpp
+
+Description:
+  Runtime selectable ways of waiting on and reading
+  the serial port
+
+*/
+
+#include "rfdf_io.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <algorithm>
+
+#ifdef RFDF_HAVE_IO_URING
+#include "rfdf_io_uring.h"
+#endif
+
+
+rfdf_io *rfdf_io::create(const char *mode, int spin_us, int sleep_us)
+{
+    if (!strcmp(mode, "sleep"))
+        return new rfdf_io_sleep(sleep_us);
+    if (!strcmp(mode, "hybrid"))
+        return new rfdf_io_hybrid(spin_us);
+    if (!strcmp(mode, "uring"))
+    {
+#ifdef RFDF_HAVE_IO_URING
+        if (rfdf_io_uring::available())
+            return new rfdf_io_uring();
+        printf("Warning: io_uring is not available, using epoll.\n");
+#else
+        printf("Warning: built without io_uring support, using epoll.\n");
+#endif
+    }
+    else if (strcmp(mode, "epoll"))
+    {
+        printf("Warning: unknown I/O mode %s, using epoll.\n", mode);
+    }
+    return new rfdf_io_epoll();
+}
+
+// a non-blocking read that reports a hangup as EIO
+static ssize_t read_port(int fd, char *buf, size_t len)
+{
+    ssize_t cr = ::read(fd, buf, len);
+    if (cr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if (cr == 0 && len > 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return cr;
+}
+
+static double monotonic_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+
+// --------------------------------------------------------
+// sleep: the original read and sleep loop
+
+int rfdf_io_sleep::attach(int fd)
+{
+    fd_ = fd;
+    return 0;
+}
+
+void rfdf_io_sleep::detach()
+{
+    fd_ = -1;
+}
+
+ssize_t rfdf_io_sleep::read(char *buf, size_t len, int timeout_ms)
+{
+    syscalls_++;
+    ssize_t cr = read_port(fd_, buf, len);
+    if (cr == 0 && timeout_ms != 0)
+    {
+        struct timespec req = {sleep_us_ / 1000000, (sleep_us_ % 1000000) * 1000L};
+        nanosleep(&req, NULL);
+        syscalls_++;
+    }
+    if (cr > 0)
+        reads_++;
+    return cr;
+}
+
+int rfdf_io_sleep::write(const char *buf, size_t len)
+{
+    syscalls_++;
+    writes_++;
+    return ::write(fd_, buf, len) < 0 ? -1 : 0;
+}
+
+
+// --------------------------------------------------------
+// epoll: block until the port is readable
+
+rfdf_io_epoll::~rfdf_io_epoll()
+{
+    detach();
+}
+
+int rfdf_io_epoll::attach(int fd)
+{
+    detach();
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0)
+        return -1;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        int err = errno;
+        detach();
+        errno = err;
+        return -1;
+    }
+    fd_ = fd;
+    return 0;
+}
+
+void rfdf_io_epoll::detach()
+{
+    if (epfd_ >= 0)
+        close(epfd_);
+    epfd_ = -1;
+    fd_ = -1;
+    queued_ = 0;
+}
+
+ssize_t rfdf_io_epoll::read(char *buf, size_t len, int timeout_ms)
+{
+    struct epoll_event ev;
+    int r;
+
+    do
+    {
+        syscalls_++;
+        r = epoll_wait(epfd_, &ev, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0)
+        return r;
+
+    syscalls_++;
+    ssize_t cr = read_port(fd_, buf, len);
+    if (cr > 0)
+        reads_++;
+    return cr;
+}
+
+int rfdf_io_epoll::write(const char *buf, size_t len)
+{
+    if (len > RFDF_IO_WRITE_SIZE)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (queued_ == RFDF_IO_MAX_WRITES && flush() < 0)
+        return -1;
+    memcpy(queue_[queued_], buf, len);
+    queue_len_[queued_] = len;
+    queued_++;
+    return 0;
+}
+
+// all queued writes in a single writev
+int rfdf_io_epoll::flush()
+{
+    if (queued_ == 0)
+        return 0;
+
+    struct iovec iov[RFDF_IO_MAX_WRITES];
+    for (int i = 0; i < queued_; i++)
+    {
+        iov[i].iov_base = queue_[i];
+        iov[i].iov_len = queue_len_[i];
+    }
+    syscalls_++;
+    writes_ += queued_;
+    ssize_t r = writev(fd_, iov, queued_);
+    queued_ = 0;
+    return r < 0 ? -1 : 0;
+}
+
+
+// --------------------------------------------------------
+// hybrid: spin while frames are close together, else epoll
+
+void rfdf_io_hybrid::arrived(double now)
+{
+    if (last_ > 0)
+    {
+        double gap = now - last_;
+        if (gap_ == 0)
+        {
+            gap_ = gap;
+            gap_dev_ = gap / 2;
+        }
+        else
+        {
+            gap_dev_ += (fabs(gap - gap_) - gap_dev_) / 4;
+            gap_ += (gap - gap_) / 8;
+        }
+        double window = gap_ + 4 * gap_dev_;
+        spin_ = gap_ < max_spin_ ? std::min(window, max_spin_) : 0;
+    }
+    last_ = now;
+}
+
+ssize_t rfdf_io_hybrid::read(char *buf, size_t len, int timeout_ms)
+{
+    double now = monotonic_now();
+    ssize_t cr;
+
+    // inside the window after the last frame: poll the port directly
+    while (now - last_ < spin_)
+    {
+        syscalls_++;
+        cr = read_port(fd_, buf, len);
+        if (cr != 0)
+        {
+            if (cr > 0)
+            {
+                spins_++;
+                reads_++;
+                arrived(monotonic_now());
+            }
+            return cr;
+        }
+        cpu_relax();
+        now = monotonic_now();
+    }
+
+    sleeps_++;
+    cr = rfdf_io_epoll::read(buf, len, timeout_ms);
+    if (cr > 0)
+        arrived(monotonic_now());
+    return cr;
+}
@@ -0,0 +1,419 @@
+/**********************************************************
+rfdf_io_uring.cpp
+
+Description:
+  io_uring backend for the serial port, using the raw
+  io_uring_setup / io_uring_enter system calls
+
+*/
+
+#include "rfdf_io_uring.h"
+
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define URING_ENTRIES 64
+
+// user_data tags of the submissions
+#define URING_TAG_POLL 1
+#define URING_TAG_READ 2
+#define URING_TAG_WRITE 3
+#define URING_TAG_CANCEL 4
+
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       const void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+bool rfdf_io_uring::available()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = uring_setup(4, &p);
+    if (fd < 0)
+        return false;
+    close(fd);
+    // the wait timeout is passed through IORING_ENTER_EXT_ARG
+    return (p.features & IORING_FEAT_EXT_ARG) && (p.features & IORING_FEAT_NODROP);
+}
+
+rfdf_io_uring::~rfdf_io_uring()
+{
+    detach();
+}
+
+int rfdf_io_uring::setup()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring_fd_ = uring_setup(URING_ENTRIES, &p);
+    if (ring_fd_ < 0)
+        return -1;
+
+    sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (cq_map_size_ > sq_map_size_)
+            sq_map_size_ = cq_map_size_;
+        cq_map_size_ = 0;
+    }
+
+    sq_map_ = mmap(NULL, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_map_ == MAP_FAILED)
+    {
+        sq_map_ = nullptr;
+        teardown();
+        return -1;
+    }
+    if (cq_map_size_)
+    {
+        cq_map_ = mmap(NULL, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_map_ == MAP_FAILED)
+        {
+            cq_map_ = nullptr;
+            teardown();
+            return -1;
+        }
+    }
+    sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe *)mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED)
+    {
+        sqes_ = nullptr;
+        teardown();
+        return -1;
+    }
+
+    char *sq = (char *)sq_map_;
+    char *cq = cq_map_ ? (char *)cq_map_ : sq;
+    sq_head_ = (unsigned *)(sq + p.sq_off.head);
+    sq_tail_ = (unsigned *)(sq + p.sq_off.tail);
+    sq_mask_ = (unsigned *)(sq + p.sq_off.ring_mask);
+    sq_array_ = (unsigned *)(sq + p.sq_off.array);
+    cq_head_ = (unsigned *)(cq + p.cq_off.head);
+    cq_tail_ = (unsigned *)(cq + p.cq_off.tail);
+    cq_mask_ = (unsigned *)(cq + p.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    sq_entries_ = p.sq_entries;
+
+    // sqe i always sits in array slot i
+    for (unsigned i = 0; i < sq_entries_; i++)
+        sq_array_[i] = i;
+    to_submit_ = 0;
+    return 0;
+}
+
+void rfdf_io_uring::teardown()
+{
+    if (sqes_)
+        munmap(sqes_, sqes_size_);
+    if (cq_map_)
+        munmap(cq_map_, cq_map_size_);
+    if (sq_map_)
+        munmap(sq_map_, sq_map_size_);
+    sqes_ = nullptr;
+    cq_map_ = nullptr;
+    sq_map_ = nullptr;
+    // closing the ring cancels whatever is still in flight
+    if (ring_fd_ >= 0)
+        close(ring_fd_);
+    ring_fd_ = -1;
+}
+
+int rfdf_io_uring::attach(int fd)
+{
+    detach();
+    if (setup() < 0)
+        return -1;
+    fd_ = fd;
+    return 0;
+}
+
+void rfdf_io_uring::detach()
+{
+    teardown();
+    fd_ = -1;
+    read_armed_ = false;
+    read_len_ = read_off_ = 0;
+    read_error_ = 0;
+    read_stopped_ = false;
+    queued_ = 0;
+    queued_bytes_ = 0;
+    write_armed_ = false;
+    write_error_ = 0;
+}
+
+struct io_uring_sqe *rfdf_io_uring::get_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail_;
+    if (tail - head >= sq_entries_)
+        return nullptr;
+    struct io_uring_sqe *sqe = &sqes_[tail & *sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+    return sqe;
+}
+
+int rfdf_io_uring::enter(unsigned wait_nr, int timeout_ms)
+{
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    unsigned flags = 0;
+    const void *argp = NULL;
+    size_t argsz = 0;
+
+    if (wait_nr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+
+    syscalls_++;
+    int r = uring_enter(ring_fd_, to_submit_, wait_nr, flags, argp, argsz);
+    if (r >= 0)
+        to_submit_ -= (unsigned)r < to_submit_ ? (unsigned)r : to_submit_;
+    if (r < 0 && (errno == ETIME || errno == EINTR))
+        return 0;
+    return r;
+}
+
+void rfdf_io_uring::reap()
+{
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+        uint64_t tag = cqe->user_data;
+        int res = cqe->res;
+
+        if (tag == URING_TAG_WRITE)
+        {
+            write_armed_ = false;
+            if (res < 0)
+                write_error_ = -res;
+            else if ((size_t)res < queued_bytes_)
+                write_error_ = EIO;
+        }
+        else if (tag == URING_TAG_POLL)
+        {
+            // a failed poll cancels the linked read, which reports the error
+            if (res > 0 && (res & (POLLHUP | POLLERR)) && !(res & POLLIN))
+                read_error_ = EIO;
+        }
+        else if (tag == URING_TAG_READ)
+        {
+            read_armed_ = false;
+            if (res > 0)
+            {
+                read_len_ = res;
+                read_off_ = 0;
+            }
+            else if (res == 0)
+            {
+                read_error_ = EIO;
+            }
+            else if (res != -EAGAIN && res != -ECANCELED && res != -EINTR)
+            {
+                read_error_ = -res;
+            }
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+ssize_t rfdf_io_uring::read(char *buf, size_t len, int timeout_ms)
+{
+    if (ring_fd_ < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (read_off_ == read_len_)
+    {
+        if (read_stopped_)
+            return 0;
+        if (!read_armed_)
+        {
+            struct io_uring_sqe *poll = get_sqe();
+            struct io_uring_sqe *rd = poll ? get_sqe() : nullptr;
+            if (!rd)
+            {
+                // ring full: push out what is queued and retry next call
+                enter(0, 0);
+                reap();
+                return 0;
+            }
+            poll->opcode = IORING_OP_POLL_ADD;
+            poll->fd = fd_;
+            poll->poll32_events = POLLIN;
+            poll->flags = IOSQE_IO_LINK;
+            poll->user_data = URING_TAG_POLL;
+
+            rd->opcode = IORING_OP_READ;
+            rd->fd = fd_;
+            rd->addr = (uint64_t)(uintptr_t)read_buf_;
+            rd->len = sizeof(read_buf_);
+            rd->off = (uint64_t)-1;
+            rd->user_data = URING_TAG_READ;
+            read_armed_ = true;
+        }
+
+        // submit the pair (and any queued writes) and wait in one call
+        if (enter(1, timeout_ms) < 0)
+            return -1;
+        reap();
+        if (read_off_ == read_len_)
+        {
+            if (!read_error_)
+                return 0;
+            errno = read_error_;
+            read_error_ = 0;
+            return -1;
+        }
+    }
+
+    size_t n = read_len_ - read_off_;
+    if (n > len)
+        n = len;
+    memcpy(buf, read_buf_ + read_off_, n);
+    read_off_ += n;
+    reads_++;
+    return n;
+}
+
+int rfdf_io_uring::write(const char *buf, size_t len)
+{
+    if (ring_fd_ < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (len > RFDF_IO_WRITE_SIZE)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (queued_ == RFDF_IO_MAX_WRITES && flush() < 0)
+        return -1;
+    memcpy(slots_[queued_], buf, len);
+    iov_[queued_].iov_base = slots_[queued_];
+    iov_[queued_].iov_len = len;
+    queued_++;
+    queued_bytes_ += len;
+    writes_++;
+    return 0;
+}
+
+// send every queued write as one WRITEV and wait for it; returns -1 with
+// errno set if it failed, or EIO if it came up short
+int rfdf_io_uring::flush()
+{
+    if (ring_fd_ < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (queued_ == 0)
+        return 0;
+
+    struct io_uring_sqe *sqe = get_sqe();
+    if (!sqe)
+    {
+        enter(0, 0);
+        reap();
+        sqe = get_sqe();
+        if (!sqe)
+        {
+            errno = EBUSY;
+            return -1;
+        }
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd_;
+    sqe->addr = (uint64_t)(uintptr_t)iov_;
+    sqe->len = queued_;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = URING_TAG_WRITE;
+    write_armed_ = true;
+
+    // submit and wait in one call; a read completing meanwhile is kept
+    while (write_armed_)
+    {
+        if (enter(1, -1) < 0)
+            return -1;
+        reap();
+    }
+    queued_ = 0;
+    queued_bytes_ = 0;
+    if (write_error_)
+    {
+        errno = write_error_;
+        write_error_ = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// closing the ring would also cancel the armed read, but a read that has
+// already taken bytes from the tty would lose them with its completion
+void rfdf_io_uring::cancel()
+{
+    read_stopped_ = true;
+    if (ring_fd_ < 0 || !read_armed_)
+        return;
+
+    // cancel the poll, or the read if the poll has already fired
+    static const uint64_t targets[] = { URING_TAG_POLL, URING_TAG_READ };
+    for (uint64_t target : targets)
+    {
+        struct io_uring_sqe *sqe = get_sqe();
+        if (!sqe)
+        {
+            enter(0, 0);
+            reap();
+            sqe = get_sqe();
+        }
+        if (!sqe)
+            break;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = target;
+        sqe->user_data = URING_TAG_CANCEL;
+    }
+
+    // the read completes either with its data or as cancelled
+    while (read_armed_)
+    {
+        if (enter(1, -1) < 0)
+            break;
+        reap();
+    }
+}
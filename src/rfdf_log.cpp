@@ -0,0 +1,218 @@
+/**********************************************************
+rfdf_log.cpp
+
+Description:
+  Command line access to bearing logs written by
+  rfdf_node: block listing, time range extraction
+  and statistics
+
+*/
+const char *use_msg =
+"Usage:\n"
+"  rfdf_log [OPTIONS] info|extract|stats FILE\n\n"
+
+"  info\n"
+"    list the blocks of the log and their time ranges\n"
+"  extract\n"
+"    print the records in the time range as CSV\n"
+"  stats\n"
+"    print count, loss, bearing and latency statistics for\n"
+"    the time range\n\n"
+
+"  -f, --from=seconds\n"
+"    start of the time range (default: start of the log)\n"
+"  -t, --to=seconds\n"
+"    end of the time range (default: end of the log)\n"
+"  -h, --help\n"
+"    print this usage message\n";
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "bearing_log.h"
+
+#define RAD2DEG (180.0 / M_PI)
+
+
+static int64_t from_ns = INT64_MIN;
+static int64_t to_ns = INT64_MAX;
+
+static double wall_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// frames missing from the id sequence. The ids start over whenever the
+// receiver resets, so each run of increasing ids is counted on its own
+// instead of spanning id_min .. id_max of the whole range
+struct id_loss
+{
+    bool started = false;
+    int32_t first = 0, last = 0;
+    uint64_t received = 0;
+    uint64_t expected = 0;
+    uint64_t resets = 0;
+
+    void add(int32_t id)
+    {
+        if (started && id > last)
+        {
+            last = id;
+        }
+        else if (!started || id < last)
+        {
+            if (started)
+            {
+                expected += (uint64_t)((int64_t)last - first + 1);
+                resets++;
+            }
+            first = last = id;
+            started = true;
+        }
+        received++;
+    }
+
+    uint64_t lost() const
+    {
+        uint64_t e = expected + (started ? (uint64_t)((int64_t)last - first + 1) : 0);
+        return e > received ? e - received : 0;
+    }
+};
+
+void print_usage()
+{
+    printf("%s", use_msg);
+}
+
+void print_summary(const bearing_summary &s, const id_loss &loss)
+{
+    if (s.count == 0)
+    {
+        printf("records:      0\n");
+        return;
+    }
+    double n = (double)s.count;
+    double lost = (double)loss.lost();
+    double az = atan2(s.sum_sin_az, s.sum_cos_az) * RAD2DEG;
+    double r = sqrt(s.sum_sin_az * s.sum_sin_az + s.sum_cos_az * s.sum_cos_az) / n;
+    double el_var = s.sum_el2 / n - (s.sum_el / n) * (s.sum_el / n);
+    double lat = s.sum_latency / n;
+    double lat_var = s.sum_latency2 / n - lat * lat;
+
+    printf("records:      %llu\n", (unsigned long long)s.count);
+    printf("time:         %.6f .. %.6f (%.3f s)\n", 1e-9 * s.t_min, 1e-9 * s.t_max, 1e-9 * (s.t_max - s.t_min));
+    printf("ids:          %d .. %d, %.2f %% lost, %llu counter resets\n", s.id_min, s.id_max,
+           100.0 * lost / (n + lost), (unsigned long long)loss.resets);
+    printf("azimuth:      mean %.2f deg, circular variance %.4f\n", az < 0 ? az + 360 : az, 1 - r);
+    printf("elevation:    mean %.2f deg, std %.2f deg\n", s.sum_el / n, sqrt(el_var > 0 ? el_var : 0));
+    printf("latency:      mean %.3f ms, std %.3f ms\n", 1e3 * lat, 1e3 * sqrt(lat_var > 0 ? lat_var : 0));
+}
+
+void parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+            {"from", required_argument, 0, 'f'},
+            {"to",   required_argument, 0, 't'},
+            {"help", no_argument,       0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "f:t:h", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'f':
+            from_ns = (int64_t)(atof(optarg) * 1e9);
+            break;
+        case 't':
+            to_ns = (int64_t)(atof(optarg) * 1e9);
+            break;
+        case 'h':
+            print_usage();
+            exit(EXIT_SUCCESS);
+        default:
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+// --------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+    if (argc - optind != 2)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    const char *command = argv[optind];
+    const char *path = argv[optind + 1];
+
+    double start = wall_ms();
+    bearing_log_reader log;
+    if (log.open(path) < 0)
+    {
+        fprintf(stderr, "Error: Failed to open %s - %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (!strcmp(command, "info"))
+    {
+        printf("%zu blocks%s%s\n", log.blocks(), log.indexed() ? "" : " (no index, recovered from block headers)",
+               log.monotonic() ? "" : " (time ranges overlap, queries scan every block)");
+        for (size_t i = 0; i < log.blocks(); i++)
+        {
+            const bearing_summary &s = log.block(i).summary;
+            printf("%6zu  offset %10llu  %5llu records  %.6f .. %.6f\n", i,
+                   (unsigned long long)log.block(i).offset, (unsigned long long)s.count,
+                   1e-9 * s.t_min, 1e-9 * s.t_max);
+        }
+    }
+    else if (!strcmp(command, "extract"))
+    {
+        printf("stamp,recv_stamp,id,azimuth,elevation,device\n");
+        log.query(from_ns, to_ns, [](const bearing_record &r)
+        {
+            printf("%lld.%09lld,%lld.%09lld,%d,%.1f,%.1f,%u\n",
+                   (long long)(r.stamp / 1000000000), (long long)(r.stamp % 1000000000),
+                   (long long)(r.recv_stamp / 1000000000), (long long)(r.recv_stamp % 1000000000),
+                   r.id, r.azimuth, r.elevation, r.device);
+        });
+    }
+    else if (!strcmp(command, "stats"))
+    {
+        // the block sums cannot see counter resets, so the ids are decoded
+        id_loss loss;
+        log.query(from_ns, to_ns, [&loss](const bearing_record &r) { loss.add(r.id); });
+        print_summary(log.stats(from_ns, to_ns), loss);
+    }
+    else
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "%s took %.3f ms\n", command, wall_ms() - start);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/**********************************************************
+rfdf_parser.cpp
+
+Description:
+  Encoding and decoding of the EAI serial sentence
+  exchanged between the Gizmo 2 board and the receiver
+
+*/
+
+#include "rfdf_parser.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+// one table lookup per byte instead of eight shifts
+struct crc8_table_t
+{
+    uint8_t crc[256];
+};
+
+static constexpr crc8_table_t crc8_make_table()
+{
+    crc8_table_t t = {};
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t c = i;
+        for (int b = 0; b < 8; b++)
+            c = (c & 0x80) ? (uint8_t)((c << 1) ^ 0x07) : (uint8_t)(c << 1);
+        t.crc[i] = c;
+    }
+    return t;
+}
+
+static constexpr crc8_table_t crc8_table = crc8_make_table();
+
+uint8_t rfdf_crc8(const char *buf, size_t len)
+{
+    uint8_t c = 0;
+    for (size_t i = 0; i < len; i++)
+        c = crc8_table.crc[c ^ (uint8_t)buf[i]];
+    return c;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool rfdf_parser::parse_line(const char *line, rfdf_frame &frame)
+{
+    size_t header_len;
+    if (sentence_lookup(line, strlen(line), &header_len) != SENTENCE_EAI)
+        return false;
+    return parse_eai(line + header_len, frame);
+}
+
+bool rfdf_parser::parse_eai(const char *payload, rfdf_frame &frame)
+{
+    frame.elevation = 0;
+    frame.azimuth = 0;
+    frame.id = 0;
+
+    // all three fields; a line cut short by noise is not a bearing
+    int r = sscanf(payload, "%f,%f,%d;", &frame.elevation, &frame.azimuth, &frame.id);
+    return r == 3;
+}
+
+size_t rfdf_parser::sentence_length(const char *line, size_t len, size_t header_len)
+{
+    const char *semi = (const char *)memchr(line + header_len, ';', len - header_len);
+    if (!semi)
+        return len;
+    size_t n = semi + 1 - line;
+    if (n < len && line[n] == '*')
+        n = std::min(n + 3, len);
+    return n;
+}
+
+rfdf_checksum rfdf_parser::check(const char *line, size_t len)
+{
+    const char *star = (const char *)memchr(line, '*', len);
+    if (!star)
+        return CHECKSUM_NONE;
+
+    // *HH ends the sentence, only the line ending may follow
+    size_t end = len;
+    while (end > 0 && (line[end - 1] == '\n' || line[end - 1] == '\r'))
+        end--;
+    size_t pos = star - line;
+    if (pos == 0 || end != pos + 3 || line[pos - 1] != ';')
+        return CHECKSUM_BAD;
+    int hi = hex_digit(star[1]), lo = hex_digit(star[2]);
+    if (hi < 0 || lo < 0)
+        return CHECKSUM_BAD;
+    return rfdf_crc8(line, pos) == (hi << 4 | lo) ? CHECKSUM_OK : CHECKSUM_BAD;
+}
+
+bool rfdf_signal::parse(const char *payload, rfdf_signal &s)
+{
+    // both fields; a line cut short by noise is not a reading
+    return sscanf(payload, "%f,%d;", &s.strength, &s.id) == 2;
+}
+
+bool rfdf_channel::parse(const char *payload, rfdf_channel &c)
+{
+    return sscanf(payload, "%d;", &c.channel) == 1;
+}
+
+bool rfdf_health::parse(const char *payload, rfdf_health &h)
+{
+    return sscanf(payload, "%u;", &h.flags) == 1;
+}
+
+int rfdf_encode(char *buf, size_t size, float elevation, float azimuth, int id,
+                bool checksum)
+{
+    if (!checksum)
+        return snprintf(buf, size, "EAI%08.1f,%08.1f,%010d;\n", elevation, azimuth, id);
+
+    int len = snprintf(buf, size, "EAI%08.1f,%08.1f,%010d;", elevation, azimuth, id);
+    if (len < 0 || (size_t)len >= size)
+        return len;
+    return len + snprintf(buf + len, size - len, "*%02X\n", rfdf_crc8(buf, len));
+}
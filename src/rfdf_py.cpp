@@ -0,0 +1,259 @@
+/**********************************************************
+rfdf_py.cpp
+
+Description:
+  Python bindings (module rfdf_native) of the EAI framer,
+  parser and the bearing log reader, for offline analysis
+
+*/
+
+// Columns come back as NumPy arrays that own the vectors they were decoded
+// into, so nothing is copied on the way to Python, and the GIL is released
+// while a capture is parsed.
+//
+//   import rfdf_native
+//   with open("capture.raw", "rb") as f:
+//       frames = rfdf_native.parse(f.read())
+//   frames["azimuth"].mean()
+//
+//   log = rfdf_native.read_log("bearings.rfdflog")
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "rfdf_parser.h"
+#include "bearing_log.h"
+
+namespace py = pybind11;
+
+// bytes per EAI sentence, to size the columns up front
+#define PY_SENTENCE_SIZE 30
+
+
+// hand v to NumPy without a copy; the array keeps the vector alive
+template <typename T>
+static py::array_t<T> to_array(std::vector<T> &&v)
+{
+    std::vector<T> *owner = new std::vector<T>(std::move(v));
+    py::capsule free_owner(owner, [](void *p) { delete reinterpret_cast<std::vector<T> *>(p); });
+    return py::array_t<T>(owner->size(), owner->data(), free_owner);
+}
+
+// contiguous bytes of any buffer: bytes, bytearray, mmap, uint8 arrays
+static const char *buffer_bytes(const py::buffer_info &info, size_t &len)
+{
+    if (info.ndim > 1 || (info.ndim == 1 && info.strides[0] != info.itemsize))
+        throw py::value_error("expected a contiguous buffer");
+    len = info.size * info.itemsize;
+    return (const char *)info.ptr;
+}
+
+
+// --------------------------------------------------------
+// Parser
+
+class py_parser
+{
+public:
+    py_parser(bool require_checksum)
+    {
+        parser_.require_checksum_ = require_checksum;
+    }
+
+    // frames decoded from data as columns; partial lines carry over
+    py::dict feed(py::buffer data)
+    {
+        py::buffer_info info = data.request();
+        size_t len;
+        const char *buf = buffer_bytes(info, len);
+
+        std::vector<int32_t> id;
+        std::vector<float> elevation, azimuth;
+        {
+            py::gil_scoped_release release;
+            // other threads may feed the same parser while the GIL is free
+            std::lock_guard<std::mutex> lock(mutex_);
+            id.reserve(len / PY_SENTENCE_SIZE);
+            elevation.reserve(len / PY_SENTENCE_SIZE);
+            azimuth.reserve(len / PY_SENTENCE_SIZE);
+            parser_.feed(buf, len, 0, [&](const rfdf_frame &frame)
+            {
+                id.push_back(frame.id);
+                elevation.push_back(frame.elevation);
+                azimuth.push_back(frame.azimuth);
+            });
+        }
+
+        py::dict d;
+        d["id"] = to_array(std::move(id));
+        d["elevation"] = to_array(std::move(elevation));
+        d["azimuth"] = to_array(std::move(azimuth));
+        return d;
+    }
+
+    py::dict stats()
+    {
+        rfdf_stats s;
+        {
+            py::gil_scoped_release release;
+            std::lock_guard<std::mutex> lock(mutex_);
+            s = parser_.stats_;
+        }
+        py::dict d;
+        d["bytes"] = s.bytes;
+        d["frames"] = s.frames;
+        d["parse_errors"] = s.parse_errors;
+        d["overflows"] = s.overflows;
+        d["unknown"] = s.unknown;
+        d["checksum_errors"] = s.checksum_errors;
+        d["resyncs"] = s.resyncs;
+        return d;
+    }
+
+    void reset()
+    {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> lock(mutex_);
+        parser_.reset();
+    }
+
+private:
+    rfdf_parser parser_;
+    std::mutex mutex_;
+};
+
+static py::dict parse(py::buffer data, bool require_checksum)
+{
+    py_parser p(require_checksum);
+    py::dict d = p.feed(data);
+    d["stats"] = p.stats();
+    return d;
+}
+
+static py::bytes encode(float elevation, float azimuth, int id, bool checksum)
+{
+    char buf[RFDF_LINE_SIZE];
+    int len = rfdf_encode(buf, sizeof(buf), elevation, azimuth, id, checksum);
+    return py::bytes(buf, len);
+}
+
+static int crc8(py::buffer data)
+{
+    py::buffer_info info = data.request();
+    size_t len;
+    const char *buf = buffer_bytes(info, len);
+    return rfdf_crc8(buf, len);
+}
+
+
+// --------------------------------------------------------
+// Bearing logs
+
+static void open_log(bearing_log_reader &log, const std::string &path)
+{
+    if (log.open(path.c_str()) < 0)
+    {
+        if (!errno)
+            errno = EINVAL;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        throw py::error_already_set();
+    }
+}
+
+// every record with t0 <= stamp <= t1 [ns] as columns
+static py::dict read_log(const std::string &path, int64_t t0, int64_t t1)
+{
+    bearing_log_reader log;
+    open_log(log, path);
+
+    std::vector<int64_t> stamp, recv_stamp;
+    std::vector<int32_t> id;
+    std::vector<float> azimuth, elevation;
+    std::vector<uint16_t> device;
+    {
+        py::gil_scoped_release release;
+        bearing_summary s = log.stats(t0, t1);
+        stamp.reserve(s.count);
+        recv_stamp.reserve(s.count);
+        id.reserve(s.count);
+        azimuth.reserve(s.count);
+        elevation.reserve(s.count);
+        device.reserve(s.count);
+        log.query(t0, t1, [&](const bearing_record &r)
+        {
+            stamp.push_back(r.stamp);
+            recv_stamp.push_back(r.recv_stamp);
+            id.push_back(r.id);
+            azimuth.push_back(r.azimuth);
+            elevation.push_back(r.elevation);
+            device.push_back(r.device);
+        });
+    }
+
+    py::dict d;
+    d["stamp"] = to_array(std::move(stamp));
+    d["recv_stamp"] = to_array(std::move(recv_stamp));
+    d["id"] = to_array(std::move(id));
+    d["azimuth"] = to_array(std::move(azimuth));
+    d["elevation"] = to_array(std::move(elevation));
+    d["device"] = to_array(std::move(device));
+    return d;
+}
+
+// summary of [t0, t1] from the block sums, decoding only the edge blocks
+static py::dict log_stats(const std::string &path, int64_t t0, int64_t t1)
+{
+    bearing_log_reader log;
+    open_log(log, path);
+
+    bearing_summary s;
+    {
+        py::gil_scoped_release release;
+        s = log.stats(t0, t1);
+    }
+    py::dict d;
+    d["count"] = s.count;
+    d["t_min"] = s.t_min;
+    d["t_max"] = s.t_max;
+    d["id_min"] = s.id_min;
+    d["id_max"] = s.id_max;
+    d["sum_sin_az"] = s.sum_sin_az;
+    d["sum_cos_az"] = s.sum_cos_az;
+    d["sum_el"] = s.sum_el;
+    d["sum_el2"] = s.sum_el2;
+    d["sum_latency"] = s.sum_latency;
+    d["sum_latency2"] = s.sum_latency2;
+    return d;
+}
+
+
+// --------------------------------------------------------
+// module
+
+PYBIND11_MODULE(rfdf_native, m)
+{
+    m.doc() = "EAI framer, parser and bearing log reader of rfdf_node";
+
+    py::class_<py_parser>(m, "Parser")
+        .def(py::init<bool>(), py::arg("require_checksum") = false)
+        .def("feed", &py_parser::feed, py::arg("data"),
+             "Decode bytes; returns id, elevation and azimuth arrays. "
+             "Partial lines carry over to the next call.")
+        .def("reset", &py_parser::reset)
+        .def_property_readonly("stats", &py_parser::stats);
+
+    m.def("parse", &parse, py::arg("data"), py::arg("require_checksum") = false,
+          "Decode a whole capture; returns id, elevation and azimuth arrays and stats.");
+    m.def("encode", &encode, py::arg("elevation"), py::arg("azimuth"), py::arg("id"),
+          py::arg("checksum") = false, "The EAI sentence rfdf_node sends for one heading.");
+    m.def("crc8", &crc8, py::arg("data"), "Sentence checksum, CRC-8 polynomial 0x07.");
+    m.def("read_log", &read_log, py::arg("path"), py::arg("t0") = INT64_MIN,
+          py::arg("t1") = INT64_MAX, "Records of a bearing log with t0 <= stamp <= t1 [ns] as arrays.");
+    m.def("log_stats", &log_stats, py::arg("path"), py::arg("t0") = INT64_MIN,
+          py::arg("t1") = INT64_MAX, "Summary sums of a bearing log over [t0, t1] [ns].");
+}
@@ -0,0 +1,54 @@
+/**********************************************************
+rfdf_reconfigure.cpp
+
+Description:
+  dynamic_reconfigure server for the live tunables of
+  rfdf_node
+
+*/
+
+#include "rfdf_reconfigure.h"
+#include <dynamic_reconfigure/server.h>
+#include <rfdf/RfdfConfig.h>
+
+
+struct rfdf_reconfigure::server
+{
+    server(ros::NodeHandle &nh) : srv(nh) {}
+
+    void changed(rfdf::RfdfConfig &config, uint32_t level)
+    {
+        rfdf_settings s;
+        s.io_backend = config.io_backend;
+        s.busy_poll_us = config.busy_poll_us;
+        s.sleep_ms = config.sleep_ms;
+        s.read_size = config.read_size;
+        s.max_batch = config.max_batch;
+        s.overload_policy = config.overload_policy;
+        s.decimate = config.decimate;
+        s.latest_period = config.latest_period;
+        s.publish_latency_high = config.publish_latency_high;
+        s.publish_latency_low = config.publish_latency_low;
+        s.baud = config.baud;
+        s.log_level = config.log_level;
+        s.echo_frames = config.echo_frames;
+        f(s);
+    }
+
+    dynamic_reconfigure::Server<rfdf::RfdfConfig> srv;
+    callback f;
+};
+
+rfdf_reconfigure::~rfdf_reconfigure()
+{
+    delete server_;
+}
+
+void rfdf_reconfigure::start(ros::NodeHandle &nh, callback f)
+{
+    delete server_;
+    server_ = new server(nh);
+    server_->f = f;
+    server *s = server_;
+    s->srv.setCallback([s](rfdf::RfdfConfig &config, uint32_t level) { s->changed(config, level); });
+}
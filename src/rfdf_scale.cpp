@@ -0,0 +1,445 @@
+/**********************************************************
+rfdf_scale.cpp
+
+Description:
+  Scalability benchmark: many pty-simulated Gizmos against
+  the receive path, for several reader threading models
+
+*/
+const char *use_msg =
+"Usage:\n"
+"  rfdf_scale [OPTIONS]\n\n"
+
+"  A transmitter thread plays N Gizmos, each on its own pty, while\n"
+"  reader threads decode the slave sides with the node's framer,\n"
+"  parser and clock sync. Every device count is run once per\n"
+"  threading model; a model is the number of reader threads the\n"
+"  devices are spread over, each waiting on its devices with epoll.\n"
+"  'N' is one thread per device, as with one rfdf_node per array.\n\n"
+
+"  Reported per run: the rate the transmitter achieved and how often\n"
+"  it fell behind, reader CPU per device, context switches of\n"
+"  the readers, resident memory per device and receive latency.\n\n"
+
+"  -n, --devices=LIST\n"
+"    comma separated device counts (default: 1,2,4,8,16,32,64)\n"
+"  -m, --models=LIST\n"
+"    comma separated reader thread counts, or N (default: 1,4,N)\n"
+"  -r, --rate=HZ\n"
+"    frames per second per device (default: 100)\n"
+"  -d, --duration=S\n"
+"    seconds of traffic per run (default: 2)\n"
+"  -j, --json\n"
+"    print one JSON object per run instead of a table\n"
+"  -h, --help\n"
+"    print this usage message\n";
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rfdf_core.h"
+#include "rfdf_parser.h"
+#include "tx_scheduler.h"
+
+#define SCALE_MAX_DEVICES 256
+
+static std::vector<int> device_counts = {1, 2, 4, 8, 16, 32, 64};
+// 0 stands for one reader thread per device
+static std::vector<int> models = {1, 4, 0};
+static double rate = 100;
+static double duration = 2;
+static int json = 0;
+
+struct device
+{
+    int master, slave;
+    rfdf_receiver receiver;
+    std::unique_ptr<std::atomic<double>[]> sent;
+    int received;
+};
+
+struct tx_result
+{
+    double rate;            // frames per device per second actually sent
+    uint64_t overruns;      // wake ups that found more than one deadline due
+    uint64_t skipped;
+};
+
+struct reader_result
+{
+    std::vector<double> latency;
+    double cpu;             // user + system [s]
+    long voluntary, involuntary;
+};
+
+struct run_result
+{
+    int devices, readers;
+    int frames, received;
+    double tx_rate;
+    uint64_t overruns, skipped;
+    double cpu_per_device;  // fraction of one core
+    double switches_per_s;
+    double rss_per_device;  // [kB]
+    double p50, p99, max;
+};
+
+
+void print_usage()
+{
+    printf("%s", use_msg);
+}
+
+static int open_pty(int &master, int &slave)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+        return -1;
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (slave < 0)
+        return -1;
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    return 0;
+}
+
+// resident set of the process [kB]
+static long rss_kb()
+{
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double tv_seconds(const struct timeval &tv)
+{
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// one frame per device per tick; all devices share the schedule, the
+// worst case for a reader that wakes for all of them at once. Deadlines
+// missed while sending are caught up, and the achieved rate tells how far
+// the transmitter fell behind the requested one
+static void transmit(std::vector<device> *devices, int frames, tx_result *res)
+{
+    char msg[RFDF_LINE_SIZE];
+    tx_scheduler sched;
+    int id = 0;
+
+    double start = rfdf_now();
+    sched.start(rate, TX_CATCH_UP);
+    while (id < frames)
+    {
+        int n = sched.wait();
+        if (n <= 0)
+            break;
+        for (; n > 0 && id < frames; n--, id++)
+        {
+            for (size_t d = 0; d < devices->size(); d++)
+            {
+                device &dev = (*devices)[d];
+                int len = rfdf_encode(msg, sizeof(msg), d % 90, (id + d) % 360, id);
+                dev.sent[id].store(rfdf_now(), std::memory_order_release);
+                // a full pty drops the frame, as a stalled reader would lose it
+                if (write(dev.master, msg, len) != len)
+                    dev.sent[id].store(NAN, std::memory_order_release);
+            }
+            sched.sent();
+        }
+    }
+    double elapsed = rfdf_now() - start;
+    res->rate = elapsed > 0 ? id / elapsed : 0;
+    res->overruns = sched.overruns_;
+    res->skipped = sched.skipped_;
+}
+
+// wait on devices [begin, end) with one epoll set until every frame is in
+// or the deadline passes
+static void reader(std::vector<device> *devices, int begin, int end, int frames,
+                   double deadline, reader_result *res)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (int d = begin; d < end; d++)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = d;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, (*devices)[d].slave, &ev);
+    }
+    res->latency.reserve((size_t)(end - begin) * frames);
+
+    struct epoll_event events[64];
+    char buf[256];
+    int open_devices = end - begin;
+    while (open_devices > 0 && rfdf_now() < deadline)
+    {
+        int n = epoll_wait(epfd, events, 64, 100);
+        for (int i = 0; i < n; i++)
+        {
+            device &dev = (*devices)[events[i].data.u32];
+            ssize_t cr;
+            while ((cr = read(dev.slave, buf, sizeof(buf))) > 0)
+            {
+                double now = rfdf_now();
+                dev.receiver.decode(buf, cr, now, [&](const rfdf_frame &frame)
+                {
+                    if (frame.id < 0 || frame.id >= frames)
+                        return;
+                    double sent = dev.sent[frame.id].load(std::memory_order_acquire);
+                    if (!isnan(sent))
+                        res->latency.push_back(now - sent);
+                    if (++dev.received == frames)
+                        open_devices--;
+                });
+            }
+        }
+    }
+    close(epfd);
+
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    res->cpu = tv_seconds(ru.ru_utime) + tv_seconds(ru.ru_stime);
+    res->voluntary = ru.ru_nvcsw;
+    res->involuntary = ru.ru_nivcsw;
+}
+
+static int reader_count(int ndev, int model)
+{
+    return model == 0 ? ndev : std::min(model, ndev);
+}
+
+static int run(int ndev, int model, run_result &out)
+{
+    int readers = reader_count(ndev, model);
+    int frames = std::max(1, (int)(rate * duration));
+    long rss_before = rss_kb();
+
+    std::vector<device> devices(ndev);
+    for (int d = 0; d < ndev; d++)
+    {
+        if (open_pty(devices[d].master, devices[d].slave) < 0)
+        {
+            fprintf(stderr, "Error: Cannot open pty %d - %s\n", d, strerror(errno));
+            return -1;
+        }
+        devices[d].sent.reset(new std::atomic<double>[frames]);
+        devices[d].received = 0;
+    }
+
+    std::vector<reader_result> results(readers);
+    std::vector<std::thread> threads;
+    double start = rfdf_now();
+    double deadline = start + duration + 2.0;
+    for (int r = 0; r < readers; r++)
+        threads.push_back(std::thread(reader, &devices, r * ndev / readers,
+                                      (r + 1) * ndev / readers, frames, deadline, &results[r]));
+    tx_result sent;
+    std::thread tx(transmit, &devices, frames, &sent);
+    tx.join();
+    // before the readers exit, while their stacks and buffers are mapped
+    long rss_after = rss_kb();
+    for (size_t r = 0; r < threads.size(); r++)
+        threads[r].join();
+    double elapsed = rfdf_now() - start;
+
+    std::vector<double> latency;
+    double cpu = 0;
+    long switches = 0;
+    for (int r = 0; r < readers; r++)
+    {
+        latency.insert(latency.end(), results[r].latency.begin(), results[r].latency.end());
+        cpu += results[r].cpu;
+        switches += results[r].voluntary + results[r].involuntary;
+    }
+    for (int d = 0; d < ndev; d++)
+    {
+        close(devices[d].slave);
+        close(devices[d].master);
+    }
+
+    out.devices = ndev;
+    out.readers = readers;
+    out.frames = frames * ndev;
+    out.received = latency.size();
+    out.tx_rate = sent.rate;
+    out.overruns = sent.overruns;
+    out.skipped = sent.skipped;
+    out.cpu_per_device = cpu / elapsed / ndev;
+    out.switches_per_s = switches / elapsed;
+    out.rss_per_device = (double)std::max(0L, rss_after - rss_before) / ndev;
+    std::sort(latency.begin(), latency.end());
+    if (latency.empty())
+        latency.push_back(NAN);
+    out.p50 = latency[latency.size() / 2];
+    out.p99 = latency[(latency.size() * 99) / 100];
+    out.max = latency.back();
+    return 0;
+}
+
+// a latency in ms for the JSON output; null when nothing was received,
+// since JSON has no NaN
+static const char *json_ms(char *buf, size_t size, double s)
+{
+    if (isnan(s))
+        return "null";
+    snprintf(buf, size, "%.4f", 1e3 * s);
+    return buf;
+}
+
+static std::vector<int> parse_list(const char *s, bool allow_n)
+{
+    std::vector<int> v;
+    std::string list = s;
+    size_t pos = 0;
+    while (pos <= list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty())
+            continue;
+        int n = (allow_n && (item == "N" || item == "n")) ? 0 : atoi(item.c_str());
+        if (n < 0 || (n == 0 && !allow_n) || n > SCALE_MAX_DEVICES)
+        {
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+        v.push_back(n);
+    }
+    return v;
+}
+
+void parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+            {"devices",  required_argument, 0, 'n'},
+            {"models",   required_argument, 0, 'm'},
+            {"rate",     required_argument, 0, 'r'},
+            {"duration", required_argument, 0, 'd'},
+            {"json",     no_argument,       0, 'j'},
+            {"help",     no_argument,       0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "n:m:r:d:jh", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'n':
+            device_counts = parse_list(optarg, false);
+            break;
+        case 'm':
+            models = parse_list(optarg, true);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'j':
+            json = 1;
+            break;
+        case 'h':
+            print_usage();
+            exit(EXIT_SUCCESS);
+        default:
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (rate <= 0 || duration <= 0 || device_counts.empty() || models.empty())
+    {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+// --------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+
+    if (!json)
+    {
+        printf("%.0f Hz per device, %.1f s per run\n\n", rate, duration);
+        printf("%7s %7s %9s %9s %9s %9s %11s %11s %9s %9s %9s\n", "devices", "readers", "tx Hz",
+               "overruns", "received", "cpu/dev %", "switches/s", "rss/dev kB", "p50 ms",
+               "p99 ms", "max ms");
+    }
+
+    for (size_t i = 0; i < device_counts.size(); i++)
+    {
+        std::vector<int> done;
+        for (size_t m = 0; m < models.size(); m++)
+        {
+            // models that come down to the same thread count run once
+            int readers = reader_count(device_counts[i], models[m]);
+            if (std::find(done.begin(), done.end(), readers) != done.end())
+                continue;
+            done.push_back(readers);
+
+            run_result r;
+            if (run(device_counts[i], models[m], r) < 0)
+                return EXIT_FAILURE;
+            if (json)
+            {
+                char p50[32], p99[32], max[32];
+                printf("{\"devices\": %d, \"readers\": %d, \"rate\": %.1f, "
+                       "\"achieved_rate\": %.1f, \"overruns\": %llu, \"skipped\": %llu, "
+                       "\"frames\": %d, \"received\": %d, \"cpu_per_device\": %.6f, "
+                       "\"switches_per_s\": %.1f, \"rss_per_device_kb\": %.1f, \"p50_ms\": %s, "
+                       "\"p99_ms\": %s, \"max_ms\": %s}\n",
+                       r.devices, r.readers, rate, r.tx_rate, (unsigned long long)r.overruns,
+                       (unsigned long long)r.skipped, r.frames, r.received, r.cpu_per_device,
+                       r.switches_per_s, r.rss_per_device, json_ms(p50, sizeof(p50), r.p50),
+                       json_ms(p99, sizeof(p99), r.p99), json_ms(max, sizeof(max), r.max));
+            }
+            else
+                printf("%7d %7d %9.1f %9llu %9d %9.3f %11.1f %11.1f %9.3f %9.3f %9.3f\n",
+                       r.devices, r.readers, r.tx_rate, (unsigned long long)r.overruns, r.received, 100 * r.cpu_per_device, r.switches_per_s, r.rss_per_device,
+                       1e3 * r.p50, 1e3 * r.p99, 1e3 * r.max);
+            fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/**********************************************************
+rfdf_serial.cpp
+
+Description:
+  Serial port setup and raw I/O shared by the rfdf
+  receiver and transmitter
+
+*/
+
+#include "rfdf_serial.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+
+serial_port::~serial_port()
+{
+    close();
+}
+
+int serial_port::open(const char *device, speed_t baud)
+{
+    close();
+    fd_ = ::open(device, O_RDWR | O_NONBLOCK | O_NOCTTY);
+    if (fd_ < 0)
+        return -1;
+    if (configure(baud) < 0)
+    {
+        int err = errno;
+        close();
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int serial_port::configure(speed_t baud)
+{
+    struct termios tio;
+
+    memset(&tio, 0, sizeof(tio));
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_cflag = CS8 | CREAD | CLOCAL;
+    tio.c_lflag = 0;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 5;
+    cfsetospeed(&tio, baud);
+    cfsetispeed(&tio, baud);
+
+    return tcsetattr(fd_, TCSANOW, &tio);
+}
+
+speed_t serial_port::speed(int baud)
+{
+    switch (baud)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+    }
+}
+
+void serial_port::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+ssize_t serial_port::read(void *buf, size_t len)
+{
+    ssize_t cr = ::read(fd_, buf, len);
+    if (cr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    // a non-blocking tty only reports end of file after a hangup
+    if (cr == 0 && len > 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return cr;
+}
+
+ssize_t serial_port::write(const void *buf, size_t len)
+{
+    return ::write(fd_, buf, len);
+}
@@ -0,0 +1,130 @@
+/**********************************************************
+rfdf_trace.cpp
+
+Description:
+  In-memory ring buffer behind the RFDF_TRACE
+  tracepoints, written to a file on stop
+
+*/
+
+#include "rfdf_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+std::atomic<bool> rfdf_trace_on(false);
+
+static rfdf_trace_record *ring = NULL;
+static size_t ring_mask = 0;
+static std::atomic<uint64_t> ring_next(0);
+// emitters between their flag check and the end of their record
+static std::atomic<int> ring_users(0);
+static char trace_path[4096];
+
+
+static uint32_t thread_id()
+{
+    static thread_local uint32_t tid = 0;
+    if (!tid)
+        tid = (uint32_t)syscall(SYS_gettid);
+    return tid;
+}
+
+// turn tracing off and wait until no emitter is still writing the ring;
+// both sides use sequentially consistent operations, so an emitter either
+// sees the flag cleared or is counted here
+static void trace_quiesce()
+{
+    rfdf_trace_on.store(false);
+    while (ring_users.load() != 0)
+        sched_yield();
+}
+
+int rfdf_trace_start(const char *path, size_t events)
+{
+    size_t n = 1;
+    while (n < events)
+        n <<= 1;
+
+    trace_quiesce();
+    delete[] ring;
+    ring = new rfdf_trace_record[n];
+    // touch the ring now so tracing never takes a page fault
+    memset(ring, 0, n * sizeof(rfdf_trace_record));
+    ring_mask = n - 1;
+    ring_next.store(0);
+    strncpy(trace_path, path, sizeof(trace_path) - 1);
+    trace_path[sizeof(trace_path) - 1] = '\0';
+    rfdf_trace_on.store(true);
+    return 0;
+}
+
+void rfdf_trace_emit(uint32_t event, int64_t a, int64_t b)
+{
+    ring_users.fetch_add(1);
+    if (!rfdf_trace_on.load())
+    {
+        ring_users.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t seq = ring_next.fetch_add(1, std::memory_order_relaxed);
+    rfdf_trace_record &r = ring[seq & ring_mask];
+    r.t = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    r.event = event;
+    r.tid = thread_id();
+    r.a = a;
+    r.b = b;
+    // seq + 1 marks the record complete; 0 is an empty slot
+    __atomic_store_n(&r.seq, seq + 1, __ATOMIC_RELEASE);
+    ring_users.fetch_sub(1, std::memory_order_release);
+}
+
+int rfdf_trace_stop()
+{
+    if (!ring)
+        return 0;
+    trace_quiesce();
+
+    FILE *f = fopen(trace_path, "wb");
+    if (!f)
+        return -1;
+
+    // oldest surviving record first
+    uint64_t end = ring_next.load();
+    uint64_t begin = end > ring_mask + 1 ? end - (ring_mask + 1) : 0;
+    uint64_t count = 0;
+    fwrite(RFDF_TRACE_MAGIC, 1, 8, f);
+    long count_pos = ftell(f);
+    fwrite(&count, sizeof(count), 1, f);
+    for (uint64_t s = begin; s < end; s++)
+    {
+        rfdf_trace_record r = ring[s & ring_mask];
+        if (r.seq != s + 1)
+            continue;
+        r.seq = s;
+        fwrite(&r, sizeof(r), 1, f);
+        count++;
+    }
+    fseek(f, count_pos, SEEK_SET);
+    fwrite(&count, sizeof(count), 1, f);
+    int err = ferror(f);
+    fclose(f);
+
+    delete[] ring;
+    ring = NULL;
+    if (err)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
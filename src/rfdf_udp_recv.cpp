@@ -0,0 +1,278 @@
+/**********************************************************
+rfdf_udp_recv.cpp
+
+Description:
+  Reference receiver for the bearing datagrams sent by
+  rfdf_node's UDP sink
+
+*/
+const char *use_msg =
+"Usage:\n"
+"  rfdf_udp_recv [OPTIONS]\n\n"
+
+"  Prints every bearing received from rfdf_node (~udp_group)\n"
+"  and counts lost datagrams per device.\n\n"
+
+"  -g, --group=ADDR\n"
+"    multicast group to join (default: 239.255.0.42)\n"
+"  -p, --port=PORT\n"
+"    UDP port (default: 5600)\n"
+"  -i, --interface=ADDR\n"
+"    address of the interface to join the group on\n"
+"  -q, --quiet\n"
+"    only print a summary once a second\n"
+"  -h, --help\n"
+"    print this usage message\n";
+
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <map>
+#include "udp_sink.h"
+
+// datagrams taken per recvmmsg
+#define RECV_BATCH 16
+// a datagram at most this far behind the newest is late, not a restart
+#define LATE_WINDOW 1024
+
+static const char *group = UDP_BEARING_GROUP;
+static int port = UDP_BEARING_PORT;
+static const char *interface = NULL;
+static int quiet = 0;
+
+struct device_state
+{
+    uint32_t next_seq;      // one past the highest sequence number seen
+    uint64_t datagrams;
+    uint64_t bearings;
+    uint64_t lost;
+    uint64_t late;          // reordered, already counted lost by the gap
+    uint64_t restarts;
+};
+
+void print_usage()
+{
+    printf("%s", use_msg);
+}
+
+static double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static float float_from_le(const void *p)
+{
+    uint32_t u;
+    float f;
+    memcpy(&u, p, sizeof(u));
+    u = le32toh(u);
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+int open_socket()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        return -1;
+
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr)))
+    {
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (interface)
+            inet_pton(AF_INET, interface, &mreq.imr_interface);
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            return -1;
+    }
+    return fd;
+}
+
+void handle_datagram(const char *buf, size_t len, std::map<int, device_state> &devices)
+{
+    udp_bearing_header h;
+    if (len < sizeof(h))
+        return;
+    memcpy(&h, buf, sizeof(h));
+    if (le32toh(h.magic) != UDP_BEARING_MAGIC || le16toh(h.version) != UDP_BEARING_VERSION)
+        return;
+    int count = le16toh(h.count);
+    if (len < sizeof(h) + count * sizeof(udp_bearing))
+        return;
+
+    uint32_t seq = le32toh(h.seq);
+    int device = le16toh(h.device);
+    device_state &d = devices[device];
+    uint32_t gap = seq - d.next_seq;
+    if (d.datagrams == 0 || gap == 0)
+    {
+        d.next_seq = seq + 1;
+    }
+    else if (gap < 0x80000000u)
+    {
+        d.lost += gap;
+        d.next_seq = seq + 1;
+    }
+    else if (d.next_seq - seq <= LATE_WINDOW)
+    {
+        // it fills part of a gap seen earlier
+        d.late++;
+        if (d.lost > 0)
+            d.lost--;
+    }
+    else
+    {
+        // a sender restart shows up as a jump back
+        d.restarts++;
+        d.next_seq = seq + 1;
+    }
+    d.datagrams++;
+    d.bearings += count;
+
+    if (quiet)
+        return;
+    double now = wall_time();
+    const udp_bearing *r = (const udp_bearing *)(buf + sizeof(h));
+    for (int i = 0; i < count; i++)
+    {
+        int64_t stamp = (int64_t)le64toh((uint64_t)r[i].stamp);
+        printf("%u %d %d %lld.%09lld %.1f %.1f %.3f ms\n", seq, device,
+               (int32_t)le32toh((uint32_t)r[i].id),
+               (long long)(stamp / 1000000000), (long long)(stamp % 1000000000),
+               float_from_le((const char *)&r[i] + offsetof(udp_bearing, azimuth)),
+               float_from_le((const char *)&r[i] + offsetof(udp_bearing, elevation)),
+               1e3 * (now - 1e-9 * stamp));
+    }
+}
+
+void parse_options(int argc, char** argv)
+{
+    int c;
+
+    while (1)
+    {
+        static struct option lopts[] =
+        {
+            {"group",     required_argument, 0, 'g'},
+            {"port",      required_argument, 0, 'p'},
+            {"interface", required_argument, 0, 'i'},
+            {"quiet",     no_argument,       0, 'q'},
+            {"help",      no_argument,       0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "g:p:i:qh", lopts, &option_index);
+
+        // end of options
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'g':
+            group = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'i':
+            interface = optarg;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'h':
+            print_usage();
+            exit(EXIT_SUCCESS);
+        default:
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+// --------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+    parse_options(argc, argv);
+
+    int fd = open_socket();
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Cannot receive on %s:%d - %s\n", group, port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    static char bufs[RECV_BATCH][sizeof(udp_bearing_header) + UDP_BEARING_MAX * sizeof(udp_bearing)];
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    std::map<int, device_state> devices;
+    double next_summary = wall_time() + 1;
+
+    while (1)
+    {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < RECV_BATCH; i++)
+        {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = sizeof(bufs[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        // wait for the first datagram, then take whatever else is queued
+        int n = recvmmsg(fd, msgs, RECV_BATCH, MSG_WAITFORONE, NULL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error: recvmmsg - %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < n; i++)
+            handle_datagram(bufs[i], msgs[i].msg_len, devices);
+
+        if (quiet && wall_time() >= next_summary)
+        {
+            next_summary += 1;
+            for (std::map<int, device_state>::iterator it = devices.begin(); it != devices.end(); ++it)
+                printf("device %d: %llu datagrams, %llu bearings, %llu lost, %llu late, "
+                       "%llu restarts\n", it->first,
+                       (unsigned long long)it->second.datagrams,
+                       (unsigned long long)it->second.bearings,
+                       (unsigned long long)it->second.lost,
+                       (unsigned long long)it->second.late,
+                       (unsigned long long)it->second.restarts);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/**********************************************************
+tracker_service.cpp
+
+Description:
+  PredictBearing service of rfdf_node, served from the
+  tracker's shared memory
+
+*/
+
+#include "tracker_service.h"
+#include <rfdf/PredictBearing.h>
+
+
+struct tracker_service::handler
+{
+    const tracker_shm *shm;
+
+    bool predict(rfdf::PredictBearing::Request &req, rfdf::PredictBearing::Response &res)
+    {
+        double t = req.stamp.isZero() ? ros::Time::now().toSec() : req.stamp.toSec();
+        bearing_prediction p;
+        res.valid = shm->predict(t, p);
+        if (!res.valid)
+            return true;
+        res.azimuth = p.azimuth;
+        res.elevation = p.elevation;
+        res.azimuth_rate = p.azimuth_rate;
+        res.elevation_rate = p.elevation_rate;
+        for (int i = 0; i < 4; i++)
+        {
+            res.azimuth_covariance[i] = p.azimuth_cov[i];
+            res.elevation_covariance[i] = p.elevation_cov[i];
+        }
+        res.age = p.age;
+        return true;
+    }
+};
+
+tracker_service::~tracker_service()
+{
+    server_ = ros::ServiceServer();
+    delete handler_;
+}
+
+void tracker_service::advertise(ros::NodeHandle &nh, const std::string &name, const tracker_shm *shm)
+{
+    if (!handler_)
+        handler_ = new handler;
+    handler_->shm = shm;
+    server_ = nh.advertiseService(name, &handler::predict, handler_);
+}
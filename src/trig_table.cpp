@@ -0,0 +1,67 @@
+/**********************************************************
+trig_table.cpp
+
+Description:
+  Table driven sin/cos for bearings reported on the
+  0.1 degree grid of the EAI sentence
+
+*/
+
+#include "trig_table.h"
+
+#include <math.h>
+
+// angles within this many table steps of a grid point use the table
+#define TRIG_TABLE_TOLERANCE 1e-3
+
+static struct trig_table
+{
+    double sin_[TRIG_TABLE_STEPS];
+
+    trig_table()
+    {
+        // first quadrant from libm, the rest by symmetry
+        int quarter = TRIG_TABLE_STEPS / 4;
+        for (int i = 0; i <= quarter; i++)
+            sin_[i] = sin(i * (2.0 * M_PI / TRIG_TABLE_STEPS));
+        sin_[0] = 0.0;
+        sin_[quarter] = 1.0;
+        for (int i = quarter + 1; i < 2 * quarter; i++)
+            sin_[i] = sin_[2 * quarter - i];
+        for (int i = 2 * quarter; i < TRIG_TABLE_STEPS; i++)
+            sin_[i] = 0.0 - sin_[i - 2 * quarter];
+    }
+} table;
+
+
+void trig_sincos_deg(double deg, double *s, double *c)
+{
+    double steps = deg * (TRIG_TABLE_STEPS / 360.0);
+    double k = nearbyint(steps);
+
+    if (fabs(steps - k) > TRIG_TABLE_TOLERANCE || fabs(k) > 1e9)
+    {
+        sincos(deg * (M_PI / 180.0), s, c);
+        return;
+    }
+
+    int i = (int)fmod(k, (double)TRIG_TABLE_STEPS);
+    if (i < 0)
+        i += TRIG_TABLE_STEPS;
+    int j = i + TRIG_TABLE_STEPS / 4;
+    if (j >= TRIG_TABLE_STEPS)
+        j -= TRIG_TABLE_STEPS;
+
+    *s = table.sin_[i];
+    *c = table.sin_[j];
+}
+
+void bearing_to_vector(double elevation, double azimuth, double *x, double *y, double *z)
+{
+    double se, ce, sa, ca;
+    trig_sincos_deg(elevation, &se, &ce);
+    trig_sincos_deg(azimuth, &sa, &ca);
+    *x = ce * ca;
+    *y = ce * sa;
+    *z = se;
+}
@@ -0,0 +1,139 @@
+/**********************************************************
+tx_scheduler.cpp
+
+Description:
+  timerfd based pacing of transmitted frames on
+  absolute deadlines
+
+*/
+
+#include "tx_scheduler.h"
+
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+
+
+static double monotonic_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void to_timespec(double t, struct timespec &ts)
+{
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+}
+
+tx_scheduler::~tx_scheduler()
+{
+    stop();
+}
+
+int tx_scheduler::start(double rate, tx_overrun_policy policy)
+{
+    stop();
+    policy_ = policy;
+    period_ = rate > 0 ? 1.0 / rate : 0;
+    start_ = monotonic_now();
+    deadline_ = 0;
+    frames_ = skipped_ = overruns_ = 0;
+    last_jitter_ = jitter_sum_ = jitter_sum2_ = jitter_max_ = 0;
+
+    if (period_ == 0)
+        return 0;
+
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd_ < 0)
+        return -1;
+
+    // absolute first expiry, then the kernel keeps the period
+    struct itimerspec its;
+    to_timespec(start_ + period_, its.it_value);
+    to_timespec(period_, its.it_interval);
+    if (timerfd_settime(fd_, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    {
+        int err = errno;
+        stop();
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void tx_scheduler::stop()
+{
+    if (fd_ >= 0)
+        close(fd_);
+    fd_ = -1;
+}
+
+int tx_scheduler::wait()
+{
+    // saturating the link: no deadlines, send whenever write() returns
+    if (period_ == 0)
+    {
+        deadline_++;
+        return 1;
+    }
+    if (fd_ < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    uint64_t expirations;
+    ssize_t r;
+    do
+    {
+        r = read(fd_, &expirations, sizeof(expirations));
+    } while (r < 0 && errno == EINTR);
+    if (r != sizeof(expirations))
+        return -1;
+
+    if (expirations > 1)
+        overruns_++;
+    if (policy_ == TX_SKIP)
+    {
+        // serve only the newest deadline
+        skipped_ += expirations - 1;
+        deadline_ += expirations;
+        return 1;
+    }
+    // serve every deadline that passed, oldest first; sent() advances
+    return (int)expirations;
+}
+
+void tx_scheduler::sent()
+{
+    double now = monotonic_now();
+    double jitter = 0;
+
+    if (period_ > 0)
+    {
+        // under TX_CATCH_UP each frame of a burst serves the next deadline
+        if (policy_ == TX_CATCH_UP)
+            deadline_++;
+        jitter = now - (start_ + deadline_ * period_);
+    }
+    frames_++;
+    last_jitter_ = jitter;
+    jitter_sum_ += jitter;
+    jitter_sum2_ += jitter * jitter;
+    if (jitter > jitter_max_)
+        jitter_max_ = jitter;
+}
+
+double tx_scheduler::rms_jitter() const
+{
+    return frames_ ? sqrt(jitter_sum2_ / frames_) : 0;
+}
@@ -0,0 +1,167 @@
+/**********************************************************
+udp_sink.cpp
+
+Description:
+  Batched UDP multicast output of parsed bearings
+
+*/
+
+#include "udp_sink.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+
+static uint32_t float_le(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return htole32(u);
+}
+
+udp_sink::~udp_sink()
+{
+    close();
+}
+
+int udp_sink::open(const char *host, int port, int ttl, const char *interface)
+{
+    if (ndest_ == UDP_SINK_MAX_DEST)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        struct addrinfo hints, *res;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        if (getaddrinfo(host, NULL, &hints, &res) != 0)
+        {
+            errno = EHOSTUNREACH;
+            return -1;
+        }
+        addr.sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+        freeaddrinfo(res);
+    }
+
+    if (fd_ < 0)
+    {
+        fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+            return -1;
+    }
+    if (IN_MULTICAST(ntohl(addr.sin_addr.s_addr)))
+    {
+        unsigned char t = ttl;
+        setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &t, sizeof(t));
+        if (interface && *interface)
+        {
+            // an interface name would silently send on the default route
+            struct in_addr ifaddr;
+            if (inet_pton(AF_INET, interface, &ifaddr) != 1)
+            {
+                printf("Error: UDP interface %s is not an IPv4 address.\n", interface);
+                errno = EINVAL;
+                return -1;
+            }
+            if (setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) < 0)
+                return -1;
+        }
+    }
+    dest_[ndest_++] = addr;
+    return 0;
+}
+
+void udp_sink::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    ndest_ = 0;
+    queued_ = 0;
+    count_ = 0;
+}
+
+void udp_sink::add(int64_t stamp, int32_t id, float azimuth, float elevation)
+{
+    if (fd_ < 0)
+        return;
+    if (queued_ == UDP_SINK_QUEUE)
+        flush();
+
+    datagram &d = queue_[queued_];
+    udp_bearing &r = d.records[count_];
+    r.stamp = (int64_t)htole64((uint64_t)stamp);
+    r.id = (int32_t)htole32((uint32_t)id);
+    uint32_t az = float_le(azimuth), el = float_le(elevation);
+    memcpy(&r.azimuth, &az, sizeof(az));
+    memcpy(&r.elevation, &el, sizeof(el));
+
+    if (++count_ == UDP_BEARING_MAX)
+        end_batch();
+}
+
+void udp_sink::end_batch()
+{
+    if (count_ == 0)
+        return;
+
+    udp_bearing_header &h = queue_[queued_].header;
+    h.magic = htole32(UDP_BEARING_MAGIC);
+    h.version = htole16(UDP_BEARING_VERSION);
+    h.count = htole16(count_);
+    h.seq = htole32(seq_++);
+    h.device = htole16(device_);
+    h.reserved = 0;
+    queued_++;
+    count_ = 0;
+}
+
+int udp_sink::flush()
+{
+    if (fd_ < 0 || queued_ == 0)
+        return 0;
+
+    struct mmsghdr msgs[UDP_SINK_QUEUE * UDP_SINK_MAX_DEST];
+    struct iovec iov[UDP_SINK_QUEUE];
+    int n = 0;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int q = 0; q < queued_; q++)
+    {
+        iov[q].iov_base = &queue_[q];
+        iov[q].iov_len = sizeof(udp_bearing_header) + le16toh(queue_[q].header.count) * sizeof(udp_bearing);
+        for (int d = 0; d < ndest_; d++, n++)
+        {
+            msgs[n].msg_hdr.msg_name = &dest_[d];
+            msgs[n].msg_hdr.msg_namelen = sizeof(dest_[d]);
+            msgs[n].msg_hdr.msg_iov = &iov[q];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    queued_ = 0;
+
+    // a full socket buffer drops datagrams rather than stalling the reader
+    int r = sendmmsg(fd_, msgs, n, MSG_DONTWAIT);
+    if (r < 0)
+    {
+        errors_ += n;
+        return -1;
+    }
+    sent_ += r;
+    errors_ += n - r;
+    return 0;
+}